@@ -0,0 +1,447 @@
+#include "AddressEncoder.hpp"
+
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+  const char BASE58_ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  const char BECH32_CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+  const uint32_t BECH32_CONSTANT = 1;
+  const uint32_t BECH32M_CONSTANT = 0x2bc830a3;
+  const size_t MAX_WITNESS_PROGRAM = 40;
+
+  struct CachedAddress
+  {
+    uint64_t key = 0;
+    uint8_t length = 0;
+    char text[MAX_ADDRESS_LENGTH];
+  };
+
+  // 스레드별 direct-mapped 캐시. 크기가 고정되어 있어 메모리 사용량이 제한된다.
+  thread_local std::vector<CachedAddress> addressCache(ADDRESS_CACHE_SIZE);
+
+  uint32_t bech32Polymod(const unsigned char *values, size_t length)
+  {
+    static const uint32_t GENERATOR[] = {0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3};
+    uint32_t chk = 1;
+    for (size_t i = 0; i < length; ++i)
+    {
+      uint32_t top = chk >> 25;
+      chk = ((chk & 0x1ffffff) << 5) ^ values[i];
+      for (int j = 0; j < 5; ++j)
+      {
+        if ((top >> j) & 1)
+          chk ^= GENERATOR[j];
+      }
+    }
+    return chk;
+  }
+}
+
+const char *addressTypeName(blocksci::AddressType::Enum type)
+{
+  using blocksci::AddressType;
+  switch (type)
+  {
+  case AddressType::PUBKEY:
+    return "pubkey";
+  case AddressType::PUBKEYHASH:
+    return "pubkeyhash";
+  case AddressType::MULTISIG_PUBKEY:
+    return "multisig_pubkey";
+  case AddressType::SCRIPTHASH:
+    return "scripthash";
+  case AddressType::MULTISIG:
+    return "multisig";
+  case AddressType::NULL_DATA:
+    return "nulldata";
+  case AddressType::WITNESS_PUBKEYHASH:
+    return "witness_pubkeyhash";
+  case AddressType::WITNESS_SCRIPTHASH:
+    return "witness_scripthash";
+  case AddressType::WITNESS_UNKNOWN:
+    return "witness_unknown";
+  default:
+    return "nonstandard";
+  }
+}
+
+AddressEncoder::AddressEncoder(blocksci::Blockchain &chain)
+    : access(chain.getAccess()),
+      pubkeyPrefix(access.config.chainConfig.pubkeyPrefix),
+      scriptPrefix(access.config.chainConfig.scriptPrefix),
+      segwitPrefix(access.config.chainConfig.segwitPrefix)
+{
+}
+
+size_t AddressEncoder::encode(const blocksci::Address &address, char *out) const
+{
+  using blocksci::AddressType;
+  namespace script = blocksci::script;
+
+  switch (address.type)
+  {
+  case AddressType::PUBKEYHASH:
+  {
+    auto hash = script::PubkeyHash(address.scriptNum, access).getPubkeyHash();
+    return encodeBase58Check(pubkeyPrefix, hash.begin(), hash.size(), out);
+  }
+  case AddressType::PUBKEY:
+  {
+    auto hash = script::Pubkey(address.scriptNum, access).getPubkeyHash();
+    return encodeBase58Check(pubkeyPrefix, hash.begin(), hash.size(), out);
+  }
+  case AddressType::MULTISIG_PUBKEY:
+  {
+    auto hash = script::MultisigPubkey(address.scriptNum, access).getPubkeyHash();
+    return encodeBase58Check(pubkeyPrefix, hash.begin(), hash.size(), out);
+  }
+  case AddressType::SCRIPTHASH:
+  {
+    auto hash = script::ScriptHash(address.scriptNum, access).getUint160();
+    return encodeBase58Check(scriptPrefix, hash.begin(), hash.size(), out);
+  }
+  case AddressType::WITNESS_PUBKEYHASH:
+  {
+    auto hash = script::WitnessPubkeyHash(address.scriptNum, access).getPubkeyHash();
+    return encodeSegwit(0, hash.begin(), hash.size(), out);
+  }
+  case AddressType::WITNESS_SCRIPTHASH:
+  {
+    auto hash = script::WitnessScriptHash(address.scriptNum, access).getUint256();
+    return encodeSegwit(0, hash.begin(), hash.size(), out);
+  }
+  case AddressType::WITNESS_UNKNOWN:
+  {
+    script::WitnessUnknown witness(address.scriptNum, access);
+    auto data = witness.getWitnessData();
+    unsigned char program[MAX_WITNESS_PROGRAM];
+    size_t length = data.size();
+    // v0 은 20/32 바이트만 유효한 주소가 된다
+    if (length < 2 || length > MAX_WITNESS_PROGRAM ||
+        (witness.witnessVersion() == 0 && length != 20 && length != 32))
+      return encodeScriptId(addressTypeName(address.type), address.scriptNum, out);
+    std::copy(data.begin(), data.end(), program);
+    return encodeSegwit(witness.witnessVersion(), program, length, out);
+  }
+  case AddressType::MULTISIG:
+    return encodeScriptId(addressTypeName(address.type), address.scriptNum, out);
+  case AddressType::NULL_DATA:
+    return encodeScriptId(addressTypeName(address.type), address.scriptNum, out);
+  default:
+    return encodeScriptId(addressTypeName(address.type), address.scriptNum, out);
+  }
+}
+
+std::string AddressEncoder::encode(const blocksci::Address &address) const
+{
+  uint64_t key = addressKey(address);
+  auto &entry = addressCache[((key * 0x9E3779B97F4A7C15ULL) >> 32) % ADDRESS_CACHE_SIZE];
+  if (entry.key != key)
+  {
+    entry.length = static_cast<uint8_t>(encode(address, entry.text));
+    entry.key = key;
+  }
+  return std::string(entry.text, entry.length);
+}
+
+size_t AddressEncoder::payload(const blocksci::Address &address, unsigned char *out) const
+{
+  using blocksci::AddressType;
+  namespace script = blocksci::script;
+
+  auto write = [out](unsigned char kind, const unsigned char *data, size_t length)
+  {
+    out[0] = kind;
+    std::memcpy(out + 1, data, length);
+    return length + 1;
+  };
+
+  switch (address.type)
+  {
+  case AddressType::PUBKEYHASH:
+  {
+    auto hash = script::PubkeyHash(address.scriptNum, access).getPubkeyHash();
+    return write(PAYLOAD_PUBKEYHASH, hash.begin(), hash.size());
+  }
+  case AddressType::PUBKEY:
+  {
+    auto hash = script::Pubkey(address.scriptNum, access).getPubkeyHash();
+    return write(PAYLOAD_PUBKEYHASH, hash.begin(), hash.size());
+  }
+  case AddressType::MULTISIG_PUBKEY:
+  {
+    auto hash = script::MultisigPubkey(address.scriptNum, access).getPubkeyHash();
+    return write(PAYLOAD_PUBKEYHASH, hash.begin(), hash.size());
+  }
+  case AddressType::WITNESS_PUBKEYHASH:
+  {
+    auto hash = script::WitnessPubkeyHash(address.scriptNum, access).getPubkeyHash();
+    return write(PAYLOAD_PUBKEYHASH, hash.begin(), hash.size());
+  }
+  case AddressType::SCRIPTHASH:
+  {
+    auto hash = script::ScriptHash(address.scriptNum, access).getUint160();
+    return write(PAYLOAD_SCRIPTHASH, hash.begin(), hash.size());
+  }
+  case AddressType::WITNESS_SCRIPTHASH:
+  {
+    auto hash = script::WitnessScriptHash(address.scriptNum, access).getUint256();
+    return write(PAYLOAD_WITNESS_SCRIPTHASH, hash.begin(), hash.size());
+  }
+  case AddressType::WITNESS_UNKNOWN:
+  {
+    script::WitnessUnknown witness(address.scriptNum, access);
+    auto data = witness.getWitnessData();
+    size_t length = data.size();
+    if (length < 2 || length > MAX_WITNESS_PROGRAM ||
+        (witness.witnessVersion() == 0 && length != 20 && length != 32))
+      return 0;
+    out[0] = PAYLOAD_WITNESS_UNKNOWN;
+    out[1] = witness.witnessVersion();
+    std::copy(data.begin(), data.end(), out + 2);
+    return length + 2;
+  }
+  default:
+    return 0;
+  }
+}
+
+size_t AddressEncoder::decode(const std::string &text, unsigned char *out) const
+{
+  if (text.empty() || text.size() >= MAX_ADDRESS_LENGTH)
+    return 0;
+  std::string lower = text;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c)
+                 { return std::tolower(c); });
+  if (lower.size() > segwitPrefix.size() && lower.compare(0, segwitPrefix.size(), segwitPrefix) == 0 &&
+      lower[segwitPrefix.size()] == '1')
+  {
+    // bech32 는 대소문자를 섞지 않는 한 구분하지 않는다
+    if (lower != text && std::any_of(text.begin(), text.end(), [](unsigned char c)
+                                     { return std::islower(c); }))
+      return 0;
+    return decodeSegwit(lower, out);
+  }
+  return decodeBase58Check(text, out);
+}
+
+size_t AddressEncoder::encodeBase58Check(const std::vector<unsigned char> &prefix,
+                                         const unsigned char *payload, size_t length, char *out) const
+{
+  unsigned char data[64];
+  unsigned char first[SHA256_DIGEST_LENGTH], second[SHA256_DIGEST_LENGTH];
+  size_t size = 0;
+
+  std::memcpy(data, prefix.data(), prefix.size());
+  size += prefix.size();
+  std::memcpy(data + size, payload, length);
+  size += length;
+  SHA256(data, size, first);
+  SHA256(first, sizeof(first), second);
+  std::memcpy(data + size, second, 4);
+  size += 4;
+
+  size_t zeros = 0;
+  while (zeros < size && data[zeros] == 0)
+    ++zeros;
+
+  // 리틀 엔디언 base58 자릿수
+  unsigned char digits[MAX_ADDRESS_LENGTH] = {0};
+  size_t digitCount = 0;
+  for (size_t i = zeros; i < size; ++i)
+  {
+    uint32_t carry = data[i];
+    size_t j = 0;
+    for (; j < digitCount || carry; ++j)
+    {
+      carry += 256 * static_cast<uint32_t>(digits[j]);
+      digits[j] = carry % 58;
+      carry /= 58;
+    }
+    digitCount = j;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < zeros; ++i)
+    out[n++] = '1';
+  for (size_t i = digitCount; i-- > 0;)
+    out[n++] = BASE58_ALPHABET[digits[i]];
+  return n;
+}
+
+size_t AddressEncoder::encodeSegwit(int version, const unsigned char *program, size_t length, char *out) const
+{
+  unsigned char values[MAX_ADDRESS_LENGTH + 32];
+  size_t n = 0;
+
+  for (char c : segwitPrefix)
+    values[n++] = static_cast<unsigned char>(c) >> 5;
+  values[n++] = 0;
+  for (char c : segwitPrefix)
+    values[n++] = static_cast<unsigned char>(c) & 31;
+
+  size_t dataStart = n;
+  values[n++] = static_cast<unsigned char>(version);
+  uint32_t acc = 0;
+  int bits = 0;
+  for (size_t i = 0; i < length; ++i)
+  {
+    acc = (acc << 8) | program[i];
+    bits += 8;
+    while (bits >= 5)
+    {
+      bits -= 5;
+      values[n++] = (acc >> bits) & 31;
+    }
+  }
+  if (bits > 0)
+    values[n++] = (acc << (5 - bits)) & 31;
+  size_t dataEnd = n;
+
+  for (int i = 0; i < 6; ++i)
+    values[n++] = 0;
+  uint32_t mod = bech32Polymod(values, n) ^ (version == 0 ? BECH32_CONSTANT : BECH32M_CONSTANT);
+
+  size_t pos = 0;
+  for (char c : segwitPrefix)
+    out[pos++] = c;
+  out[pos++] = '1';
+  for (size_t i = dataStart; i < dataEnd; ++i)
+    out[pos++] = BECH32_CHARSET[values[i]];
+  for (int i = 0; i < 6; ++i)
+    out[pos++] = BECH32_CHARSET[(mod >> (5 * (5 - i))) & 31];
+  return pos;
+}
+
+size_t AddressEncoder::encodeScriptId(const char *tag, uint32_t scriptNum, char *out) const
+{
+  int written = std::snprintf(out, MAX_ADDRESS_LENGTH, "%s-%u", tag, scriptNum);
+  return written < 0 ? 0 : std::min(static_cast<size_t>(written), MAX_ADDRESS_LENGTH - 1);
+}
+
+size_t AddressEncoder::decodeBase58Check(const std::string &text, unsigned char *out) const
+{
+  size_t zeros = 0;
+  while (zeros < text.size() && text[zeros] == '1')
+    ++zeros;
+
+  // 리틀 엔디언 바이트
+  unsigned char bytes[MAX_ADDRESS_LENGTH] = {0};
+  size_t byteCount = 0;
+  for (size_t i = zeros; i < text.size(); ++i)
+  {
+    const char *find = std::strchr(BASE58_ALPHABET, text[i]);
+    if (!find || text[i] == '\0')
+      return 0;
+    uint32_t carry = find - BASE58_ALPHABET;
+    size_t j = 0;
+    for (; j < byteCount || carry; ++j)
+    {
+      if (j >= sizeof(bytes))
+        return 0;
+      carry += 58 * static_cast<uint32_t>(bytes[j]);
+      bytes[j] = carry & 0xff;
+      carry >>= 8;
+    }
+    byteCount = j;
+  }
+
+  unsigned char data[64] = {0};
+  size_t size = zeros + byteCount;
+  if (size < 5 || size > sizeof(data))
+    return 0;
+  for (size_t i = 0; i < byteCount; ++i)
+    data[zeros + i] = bytes[byteCount - 1 - i];
+
+  unsigned char first[SHA256_DIGEST_LENGTH], second[SHA256_DIGEST_LENGTH];
+  SHA256(data, size - 4, first);
+  SHA256(first, sizeof(first), second);
+  if (std::memcmp(data + size - 4, second, 4) != 0)
+    return 0;
+
+  auto match = [&data, size](const std::vector<unsigned char> &prefix)
+  {
+    return size == prefix.size() + 20 + 4 && std::equal(prefix.begin(), prefix.end(), data);
+  };
+  unsigned char kind;
+  size_t prefixSize;
+  if (match(pubkeyPrefix))
+  {
+    kind = PAYLOAD_PUBKEYHASH;
+    prefixSize = pubkeyPrefix.size();
+  }
+  else if (match(scriptPrefix))
+  {
+    kind = PAYLOAD_SCRIPTHASH;
+    prefixSize = scriptPrefix.size();
+  }
+  else
+    return 0;
+  out[0] = kind;
+  std::memcpy(out + 1, data + prefixSize, 20);
+  return 21;
+}
+
+size_t AddressEncoder::decodeSegwit(const std::string &text, unsigned char *out) const
+{
+  unsigned char values[MAX_ADDRESS_LENGTH + 32];
+  size_t n = 0;
+
+  for (char c : segwitPrefix)
+    values[n++] = static_cast<unsigned char>(c) >> 5;
+  values[n++] = 0;
+  for (char c : segwitPrefix)
+    values[n++] = static_cast<unsigned char>(c) & 31;
+
+  size_t dataStart = n;
+  for (size_t i = segwitPrefix.size() + 1; i < text.size(); ++i)
+  {
+    const char *find = std::strchr(BECH32_CHARSET, text[i]);
+    if (!find || text[i] == '\0')
+      return 0;
+    values[n++] = find - BECH32_CHARSET;
+  }
+  // version 1자 + checksum 6자
+  if (n < dataStart + 7)
+    return 0;
+  int version = values[dataStart];
+  if (version > 16 || bech32Polymod(values, n) != (version == 0 ? BECH32_CONSTANT : BECH32M_CONSTANT))
+    return 0;
+
+  unsigned char program[MAX_ADDRESS_LENGTH];
+  size_t length = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (size_t i = dataStart + 1; i < n - 6; ++i)
+  {
+    acc = (acc << 5) | values[i];
+    bits += 5;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      program[length++] = (acc >> bits) & 0xff;
+    }
+  }
+  if (bits >= 5 || (acc & ((1u << bits) - 1)) != 0)
+    return 0;
+  if (length < 2 || length > MAX_WITNESS_PROGRAM)
+    return 0;
+
+  if (version == 0)
+  {
+    if (length != 20 && length != 32)
+      return 0;
+    out[0] = length == 20 ? PAYLOAD_PUBKEYHASH : PAYLOAD_WITNESS_SCRIPTHASH;
+    std::memcpy(out + 1, program, length);
+    return length + 1;
+  }
+  out[0] = PAYLOAD_WITNESS_UNKNOWN;
+  out[1] = static_cast<unsigned char>(version);
+  std::memcpy(out + 2, program, length);
+  return length + 2;
+}
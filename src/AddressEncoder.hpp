@@ -0,0 +1,67 @@
+#ifndef ADDRESSENCODER_HPP
+#define ADDRESSENCODER_HPP
+#include <blocksci/blocksci.hpp>
+#include <string>
+#include <vector>
+
+const size_t MAX_ADDRESS_LENGTH = 96;
+const size_t ADDRESS_CACHE_SIZE = 4096;
+const size_t MAX_ADDRESS_PAYLOAD = 48;
+
+// payload 의 첫 바이트. BlockSci 는 P2PK/P2PKH/P2WPKH 를 같은 pubkey 로 묶으므로 같은 종류로 둔다
+const unsigned char PAYLOAD_PUBKEYHASH = 'P';
+const unsigned char PAYLOAD_SCRIPTHASH = 'S';
+const unsigned char PAYLOAD_WITNESS_SCRIPTHASH = 'W';
+const unsigned char PAYLOAD_WITNESS_UNKNOWN = 'U';
+
+// (type, scriptNum) 을 하나의 64bit 키로. 0 은 빈 값으로 쓰인다.
+inline uint64_t addressKey(const blocksci::Address &address)
+{
+  return (static_cast<uint64_t>(address.type) + 1) << 32 | address.scriptNum;
+}
+
+inline blocksci::Address addressFromKey(uint64_t key, blocksci::DataAccess &access)
+{
+  auto type = static_cast<blocksci::AddressType::Enum>((key >> 32) - 1);
+  return blocksci::Address(static_cast<uint32_t>(key), type, access);
+}
+
+const char *addressTypeName(blocksci::AddressType::Enum type);
+
+/*
+ * Address::toString() 결과를 파싱하지 않고 스크립트 데이터로부터 직접
+ * base58check / bech32(m) 주소 문자열을 만든다.
+ * 표준 인코딩이 없는 스크립트(multisig, nonstandard, OP_RETURN)는
+ * "<type>-<scriptNum>" 형식의 고유 식별자로 표현한다.
+ */
+class AddressEncoder
+{
+public:
+  AddressEncoder(blocksci::Blockchain &chain);
+
+  // out 에 최대 MAX_ADDRESS_LENGTH 바이트를 기록하고 길이를 반환 (NUL 미포함)
+  size_t encode(const blocksci::Address &address, char *out) const;
+  // 스레드별 캐시를 거쳐 문자열 반환
+  std::string encode(const blocksci::Address &address) const;
+
+  // 주소 문자열이 가리키는 (종류, 해시/프로그램) 을 out 에 기록하고 길이를 반환.
+  // payload 는 encode 의 역이라 문자열 주소와 스크립트를 같은 키로 비교할 수 있다.
+  // 문자열 표현이 없는 스크립트, 이 체인의 주소 형식이 아니거나 체크섬이 틀리면 0
+  size_t payload(const blocksci::Address &address, unsigned char *out) const;
+  size_t decode(const std::string &text, unsigned char *out) const;
+
+private:
+  blocksci::DataAccess &access;
+  std::vector<unsigned char> pubkeyPrefix;
+  std::vector<unsigned char> scriptPrefix;
+  std::string segwitPrefix;
+
+  size_t encodeBase58Check(const std::vector<unsigned char> &prefix,
+                           const unsigned char *payload, size_t length, char *out) const;
+  size_t encodeSegwit(int version, const unsigned char *program, size_t length, char *out) const;
+  size_t encodeScriptId(const char *tag, uint32_t scriptNum, char *out) const;
+  size_t decodeBase58Check(const std::string &text, unsigned char *out) const;
+  size_t decodeSegwit(const std::string &text, unsigned char *out) const;
+};
+
+#endif
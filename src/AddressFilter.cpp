@@ -0,0 +1,204 @@
+#include "AddressFilter.hpp"
+#include "ChainLock.hpp"
+#include "MongoDB.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+  /*
+   * PUBKEYHASH 하나로 P2PK/P2PKH/P2WPKH 가 모두 들어간다 (같은 scriptNum, 같은 payload).
+   * SCRIPTHASH 는 P2SH/P2WSH 가 scriptNum 을 공유하므로 scriptNum 마다 segwit 여부로 한쪽만 넣는다.
+   */
+  const std::vector<blocksci::AddressType::Enum> FILTER_ADDRESS_TYPES = {
+      blocksci::AddressType::PUBKEYHASH, blocksci::AddressType::SCRIPTHASH,
+      blocksci::AddressType::WITNESS_UNKNOWN};
+
+  // payload 종류가 속한 scriptNum 공간의 타입 (typeCounts 의 인덱스)
+  blocksci::AddressType::Enum payloadType(unsigned char kind)
+  {
+    switch (kind)
+    {
+    case PAYLOAD_PUBKEYHASH:
+      return blocksci::AddressType::PUBKEYHASH;
+    case PAYLOAD_SCRIPTHASH:
+    case PAYLOAD_WITNESS_SCRIPTHASH:
+      return blocksci::AddressType::SCRIPTHASH;
+    default:
+      return blocksci::AddressType::WITNESS_UNKNOWN;
+    }
+  }
+
+  json filterStatus(const BlockedBloomFilter *filter, double bitsPerKey, double rate, uint64_t negatives)
+  {
+    json res;
+    res["ready"] = filter != nullptr;
+    res["keys"] = filter ? filter->size() : 0;
+    res["capacity"] = filter ? filter->capacity() : 0;
+    res["bytes"] = filter ? filter->bytes() : 0;
+    res["bits_per_key"] = bitsPerKey;
+    res["false_positive_rate"] = rate;
+    res["negatives"] = negatives;
+    return res;
+  }
+}
+
+AddressFilter::AddressFilter(blocksci::Blockchain &chain, const std::string &mongoUri, double bitsPerKey)
+    : chain(chain), mongoUri(mongoUri), bitsPerKey(bitsPerKey), addressEncoder(chain)
+{
+}
+
+uint64_t AddressFilter::update()
+{
+  auto chainLock = ChainLock::Instance().read();
+  TypeCounts counts{};
+  uint64_t total = 0, processed = 0;
+  for (auto type : FILTER_ADDRESS_TYPES)
+  {
+    counts[type] = chain.addressCount(type);
+    total += counts[type];
+    processed += typeCounts[type];
+  }
+
+  // chainFilter / typeCounts 를 바꾸는 것은 이 스레드뿐이므로 읽을 때는 잠그지 않는다
+  uint64_t added = 0;
+  if (!chainFilter || total > chainFilter->capacity())
+  {
+    auto rebuilt = std::make_unique<BlockedBloomFilter>(total * ADDRESS_FILTER_GROWTH, bitsPerKey);
+    if (!fill(*rebuilt, TypeCounts{}, counts))
+      return 0;
+    double rate = rebuilt->falsePositiveRate();
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    chainFilter = std::move(rebuilt);
+    typeCounts = counts;
+    chainRate = rate;
+    added = total;
+  }
+  else if (total > processed)
+  {
+    if (!fill(*chainFilter, typeCounts, counts))
+      return 0;
+    double rate = chainFilter->falsePositiveRate();
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    typeCounts = counts;
+    chainRate = rate;
+    added = total - processed;
+  }
+
+  try
+  {
+    updateLabels();
+  }
+  catch (const std::exception &e)
+  {
+    // 이전 라벨 필터를 그대로 쓴다
+    std::cerr << "address filter: labels: " << e.what() << std::endl;
+  }
+  return added;
+}
+
+bool AddressFilter::fill(BlockedBloomFilter &filter, const TypeCounts &from, const TypeCounts &to)
+{
+  std::vector<std::tuple<blocksci::AddressType::Enum, uint32_t, uint32_t>> ranges;
+  for (auto type : FILTER_ADDRESS_TYPES)
+  {
+    for (uint64_t first = from[type] + 1ULL; first <= to[type]; first += ADDRESS_FILTER_CHUNK)
+      ranges.emplace_back(type, first, std::min<uint64_t>(first + ADDRESS_FILTER_CHUNK, to[type] + 1ULL));
+  }
+
+  std::atomic<size_t> next{0};
+  auto work = [this, &filter, &ranges, &next]()
+  {
+    unsigned char payload[MAX_ADDRESS_PAYLOAD];
+    for (size_t i = next++; i < ranges.size() && !stopping; i = next++)
+    {
+      auto [type, first, end] = ranges[i];
+      for (uint32_t scriptNum = first; scriptNum < end; ++scriptNum)
+      {
+        auto encoded = type;
+        if (type == blocksci::AddressType::SCRIPTHASH &&
+            blocksci::script::ScriptHash(scriptNum, chain.getAccess()).getData()->isSegwit)
+          encoded = blocksci::AddressType::WITNESS_SCRIPTHASH;
+        size_t length = addressEncoder.payload(blocksci::Address(scriptNum, encoded, chain.getAccess()), payload);
+        if (length > 0)
+          filter.insert(bloomHash(payload, length));
+      }
+    }
+  };
+
+  size_t threadCount = std::min<size_t>(ranges.size(), std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < threadCount; ++i)
+    threads.emplace_back(work);
+  work();
+  for (auto &thread : threads)
+    thread.join();
+  return !stopping;
+}
+
+void AddressFilter::updateLabels()
+{
+  std::vector<uint64_t> hashes;
+  MongoDB mongo(mongoUri);
+  mongo.labelledAddresses([&hashes](const std::string &address)
+                          { hashes.push_back(bloomHash(address.data(), address.size())); });
+
+  auto rebuilt = std::make_unique<BlockedBloomFilter>(std::max<uint64_t>(hashes.size(), 1024), bitsPerKey);
+  for (uint64_t hash : hashes)
+    rebuilt->insert(hash);
+  double rate = rebuilt->falsePositiveRate();
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  labelFilter = std::move(rebuilt);
+  labelRate = rate;
+  labelsUpdated = std::chrono::steady_clock::now();
+}
+
+bool AddressFilter::absent(const std::string &address) const
+{
+  unsigned char payload[MAX_ADDRESS_PAYLOAD];
+  size_t length = addressEncoder.decode(address, payload);
+  if (length == 0)
+    return false;
+
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (!chainFilter)
+    return false;
+  ++lookups;
+  // 마지막 update() 뒤에 생긴 주소일 수 있으면 BlockSci 에 맡긴다
+  auto type = payloadType(payload[0]);
+  if (chain.addressCount(type) > typeCounts[type])
+    return false;
+  if (chainFilter->contains(bloomHash(payload, length)))
+    return false;
+  ++chainNegatives;
+  return true;
+}
+
+bool AddressFilter::mayBeLabelled(const std::string &address) const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  if (!labelFilter || labelFilter->contains(bloomHash(address.data(), address.size())))
+    return true;
+  ++labelNegatives;
+  return false;
+}
+
+json AddressFilter::status() const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  json res;
+  res["lookups"] = lookups.load();
+  res["chain"] = filterStatus(chainFilter.get(), bitsPerKey, chainRate, chainNegatives.load());
+  res["labels"] = filterStatus(labelFilter.get(), bitsPerKey, labelRate, labelNegatives.load());
+  // 이 시간 안에 Mongo 에 추가된 라벨은 아직 필터에 없어 404 가 날 수 있다
+  res["labels"]["age_seconds"] = labelFilter ? std::chrono::duration_cast<std::chrono::seconds>(
+                                                   std::chrono::steady_clock::now() - labelsUpdated).count()
+                                             : 0;
+  return res;
+}
@@ -0,0 +1,71 @@
+#ifndef ADDRESSFILTER_HPP
+#define ADDRESSFILTER_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include "AddressEncoder.hpp"
+#include "BloomFilter.hpp"
+
+using json = nlohmann::json;
+
+const double ADDRESS_FILTER_BITS_PER_KEY = 10; // 약 1% 오탐
+const double ADDRESS_FILTER_GROWTH = 1.25;     // 다시 만들 때 새 주소를 위해 남겨 두는 여유
+const uint32_t ADDRESS_FILTER_CHUNK = 1 << 20; // 채우기 작업 하나가 맡는 scriptNum 수
+
+/*
+ * 없는 주소 조회를 BlockSci 색인과 Mongo 없이 끝내기 위한 bloom filter 두 개.
+ *  - 체인: 체인에 나타난 모든 주소의 payload (AddressEncoder::payload). 문자열 주소는 decode 해서 같은 키로 찾는다.
+ *  - 라벨: Mongo clusters.address 와 profiles.target 문자열
+ * 체인 필터는 update() 마다 새 scriptNum 만 추가하고 용량을 넘으면 다시 만든다.
+ * 마지막 update() 뒤에 생긴 주소는 absent() 가 BlockSci 에 확인을 넘기므로 놓치지 않는다.
+ * 라벨 필터는 update() 나 updateLabels() 마다 다시 만들며, 그 사이 Mongo 에 추가된 라벨은 다음 갱신부터 보인다.
+ * pre-fork 모드에서는 작업 프로세스마다 updateLabels() 를 주기적으로 불러 자기 사본을 갱신한다.
+ * update() 는 한 스레드에서만 부르고, fork 전에도 부를 수 있도록 ThreadPool 대신 임시 스레드를 쓴다.
+ */
+class AddressFilter
+{
+public:
+  AddressFilter(blocksci::Blockchain &chain, const std::string &mongoUri,
+                double bitsPerKey = ADDRESS_FILTER_BITS_PER_KEY);
+
+  // 체인 필터에 새로 넣은 키 수를 반환
+  uint64_t update();
+  // 라벨 필터만 Mongo 에서 다시 만든다 (update() 와 같은 스레드나 update() 를 부르지 않는 프로세스에서)
+  void updateLabels();
+  void stop() { stopping = true; }
+
+  // 체인에 나타난 적 없는 주소가 확실하면 true. 필터가 아직 없거나 해석할 수 없는 문자열이면 false
+  bool absent(const std::string &address) const;
+  // Mongo 에 클러스터/프로필이 있을 수 있으면 true
+  bool mayBeLabelled(const std::string &address) const;
+  json status() const;
+
+private:
+  using TypeCounts = std::array<uint32_t, 16>;
+
+  blocksci::Blockchain &chain;
+  std::string mongoUri;
+  double bitsPerKey;
+  AddressEncoder addressEncoder;
+  mutable std::shared_mutex mutex;
+  std::unique_ptr<BlockedBloomFilter> chainFilter;
+  std::unique_ptr<BlockedBloomFilter> labelFilter;
+  TypeCounts typeCounts{}; // 체인 필터에 넣은 타입별 scriptNum 수
+  double chainRate = 0;
+  double labelRate = 0;
+  std::chrono::steady_clock::time_point labelsUpdated;
+  std::atomic<bool> stopping{false};
+  mutable std::atomic<uint64_t> lookups{0};
+  mutable std::atomic<uint64_t> chainNegatives{0};
+  mutable std::atomic<uint64_t> labelNegatives{0};
+
+  // from 다음부터 to 까지의 scriptNum 을 넣는다. 중간에 멈추면 false
+  bool fill(BlockedBloomFilter &filter, const TypeCounts &from, const TypeCounts &to);
+};
+
+#endif
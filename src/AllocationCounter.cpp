@@ -0,0 +1,44 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  thread_local uint64_t allocationCount = 0;
+}
+
+uint64_t threadAllocations()
+{
+  return allocationCount;
+}
+
+#ifdef TRACK_ALLOCATIONS
+bool allocationsTracked()
+{
+  return true;
+}
+
+void *operator new(size_t size)
+{
+  ++allocationCount;
+  if (void *pointer = std::malloc(size ? size : 1))
+    return pointer;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+  std::free(pointer);
+}
+#else
+bool allocationsTracked()
+{
+  return false;
+}
+#endif
@@ -0,0 +1,9 @@
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+#include <cstdint>
+
+// TRACK_ALLOCATIONS 로 빌드하면 전역 operator new 호출 수를 스레드별로 센다
+uint64_t threadAllocations();
+bool allocationsTracked();
+
+#endif
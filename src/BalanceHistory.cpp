@@ -0,0 +1,209 @@
+#include "BalanceHistory.hpp"
+#include "AddressEncoder.hpp"
+#include "ChainLock.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+  const time_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+  // balance 필드에 블록별 변화량이 담긴 배열을 높이 순 누적 잔액으로 변환
+  BalanceSeries accumulate(BalanceSeries deltas)
+  {
+    std::stable_sort(deltas.begin(), deltas.end(), [](const BalancePoint &a, const BalancePoint &b)
+                     { return a.height < b.height; });
+    BalanceSeries res;
+    res.reserve(deltas.size());
+    int64_t balance = 0;
+    uint32_t time = 0;
+    for (const auto &point : deltas)
+    {
+      balance += point.balance;
+      time = std::max(time, point.time);
+      if (!res.empty() && res.back().height == point.height)
+        res.back().balance = balance;
+      else
+        res.push_back({point.height, time, balance});
+    }
+    return res;
+  }
+
+  time_t bucketStart(time_t time, HistoryBucket bucket)
+  {
+    if (bucket == HistoryBucket::Day)
+      return time - time % SECONDS_PER_DAY;
+    struct tm date;
+    gmtime_r(&time, &date);
+    date.tm_mday = 1;
+    date.tm_hour = date.tm_min = date.tm_sec = 0;
+    return timegm(&date);
+  }
+
+  time_t nextBucket(time_t time, HistoryBucket bucket)
+  {
+    if (bucket == HistoryBucket::Day)
+      return time + SECONDS_PER_DAY;
+    struct tm date;
+    gmtime_r(&time, &date);
+    date.tm_mon += 1;
+    return timegm(&date);
+  }
+}
+
+BalanceHistory::BalanceHistory(size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<const BalanceSeries> BalanceHistory::series(const blocksci::Address &address)
+{
+  uint64_t key = addressKey(address);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropStale();
+    auto find = cache.find(key);
+    if (find != cache.end())
+    {
+      lru.splice(lru.begin(), lru, find->second.order);
+      return find->second.series;
+    }
+  }
+
+  auto built = std::make_shared<const BalanceSeries>(build(address));
+  if (built->size() > capacity)
+    return built;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (cache.count(key))
+    return cache[key].series;
+  lru.push_front(key);
+  cache[key] = Entry{built, lru.begin()};
+  cachedPoints += built->size();
+  while (cachedPoints > capacity && lru.size() > 1)
+  {
+    auto evict = cache.find(lru.back());
+    cachedPoints -= evict->second.series->size();
+    cache.erase(evict);
+    lru.pop_back();
+  }
+  return built;
+}
+
+void BalanceHistory::dropStale()
+{
+  // 체인을 다시 읽은 뒤에는 새 블록이 빠진 배열이므로 모두 버린다
+  uint64_t current = ChainLock::Instance().generation();
+  if (current == generation)
+    return;
+  cache.clear();
+  lru.clear();
+  cachedPoints = 0;
+  generation = current;
+}
+
+BalanceSeries BalanceHistory::build(const blocksci::Address &address)
+{
+  BalanceSeries deltas;
+  for (const auto &tx : address.getTransactions())
+  {
+    int64_t delta = 0;
+    for (const auto &input : tx.inputs())
+    {
+      if (input.getAddress() == address)
+        delta -= input.getValue();
+    }
+    for (const auto &output : tx.outputs())
+    {
+      if (output.getAddress() == address)
+        delta += output.getValue();
+    }
+    auto block = tx.block();
+    deltas.push_back({block.height(), block.timestamp(), delta});
+  }
+  return accumulate(std::move(deltas));
+}
+
+BalanceSeries BalanceHistory::merge(const std::vector<std::shared_ptr<const BalanceSeries>> &seriesList)
+{
+  size_t total = 0;
+  for (const auto &series : seriesList)
+    total += series->size();
+
+  BalanceSeries deltas;
+  deltas.reserve(total);
+  for (const auto &series : seriesList)
+  {
+    int64_t previous = 0;
+    for (const auto &point : *series)
+    {
+      deltas.push_back({point.height, point.time, point.balance - previous});
+      previous = point.balance;
+    }
+  }
+  return accumulate(std::move(deltas));
+}
+
+int64_t BalanceHistory::balanceAt(const BalanceSeries &series, time_t time)
+{
+  auto after = std::upper_bound(series.begin(), series.end(), time, [](time_t t, const BalancePoint &point)
+                                { return t < static_cast<time_t>(point.time); });
+  return after == series.begin() ? 0 : std::prev(after)->balance;
+}
+
+json BalanceHistory::bucketize(const BalanceSeries &series, HistoryBucket bucket, time_t start, time_t end)
+{
+  json res = json::array();
+  if (series.empty())
+    return res;
+  if (start <= 0)
+    start = series.front().time;
+  if (end <= 0)
+    end = series.back().time;
+
+  if (bucket == HistoryBucket::Block)
+  {
+    int64_t previous = 0;
+    for (const auto &point : series)
+    {
+      if (point.time > end)
+        break;
+      if (point.time >= start)
+      {
+        if (res.size() >= MAX_HISTORY_BUCKETS)
+          throw std::invalid_argument("Too many buckets, narrow the time range");
+        json doc;
+        doc["height"] = point.height;
+        doc["time"] = point.time;
+        doc["balance"] = point.balance;
+        doc["change"] = point.balance - previous;
+        res.push_back(std::move(doc));
+      }
+      previous = point.balance;
+    }
+    return res;
+  }
+
+  for (time_t cursor = bucketStart(start, bucket); cursor <= end; cursor = nextBucket(cursor, bucket))
+  {
+    if (res.size() >= MAX_HISTORY_BUCKETS)
+      throw std::invalid_argument("Too many buckets, use a coarser bucket");
+    int64_t open = balanceAt(series, cursor - 1);
+    int64_t close = balanceAt(series, nextBucket(cursor, bucket) - 1);
+    json doc;
+    doc["time"] = cursor;
+    doc["balance"] = close;
+    doc["change"] = close - open;
+    res.push_back(std::move(doc));
+  }
+  return res;
+}
+
+HistoryBucket BalanceHistory::parseBucket(const std::string &name)
+{
+  if (name == "block")
+    return HistoryBucket::Block;
+  if (name == "day")
+    return HistoryBucket::Day;
+  if (name == "month")
+    return HistoryBucket::Month;
+  throw std::invalid_argument("Invalid bucket, expected block, day or month");
+}
@@ -0,0 +1,68 @@
+#ifndef BALANCEHISTORY_HPP
+#define BALANCEHISTORY_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <ctime>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+const size_t BALANCE_CACHE_POINTS = 4 * 1024 * 1024;
+const size_t MAX_HISTORY_BUCKETS = 20000;
+
+enum class HistoryBucket
+{
+  Block,
+  Day,
+  Month
+};
+
+struct BalancePoint
+{
+  blocksci::BlockHeight height;
+  uint32_t time;   // 단조 증가하도록 보정한 블록 시간
+  int64_t balance; // 이 블록까지의 누적 잔액
+};
+
+using BalanceSeries = std::vector<BalancePoint>;
+
+/*
+ * 주소별 누적 잔액 배열(prefix sum). 임의 시점의 잔액은 이진 탐색,
+ * 구간 변화량은 두 시점 잔액의 차로 구한다.
+ * 계산된 배열은 전체 포인트 수 기준 LRU 로 캐시한다.
+ */
+class BalanceHistory
+{
+public:
+  BalanceHistory(size_t capacity = BALANCE_CACHE_POINTS);
+  std::shared_ptr<const BalanceSeries> series(const blocksci::Address &address);
+
+  static BalanceSeries merge(const std::vector<std::shared_ptr<const BalanceSeries>> &seriesList);
+  static int64_t balanceAt(const BalanceSeries &series, time_t time);
+  static json bucketize(const BalanceSeries &series, HistoryBucket bucket, time_t start, time_t end);
+  static HistoryBucket parseBucket(const std::string &name);
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<const BalanceSeries> series;
+    std::list<uint64_t>::iterator order;
+  };
+
+  size_t capacity;
+  size_t cachedPoints = 0;
+  uint64_t generation = 0; // 캐시를 채운 체인 generation
+  std::mutex mutex;
+  std::list<uint64_t> lru;
+  std::unordered_map<uint64_t, Entry> cache;
+
+  static BalanceSeries build(const blocksci::Address &address);
+  // mutex 를 잡은 채로 부른다
+  void dropStale();
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "BloomFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  const uint32_t SALT[8] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                            0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+  const uint64_t MAX_BLOCKS = 1ULL << 32;
+
+  uint64_t mix(uint64_t value)
+  {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+}
+
+uint64_t bloomHash(const void *data, size_t length)
+{
+  auto *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = mix(length * 0x9E3779B97F4A7C15ULL);
+  while (length >= 8)
+  {
+    uint64_t chunk;
+    std::memcpy(&chunk, bytes, 8);
+    hash = mix(hash ^ chunk);
+    bytes += 8;
+    length -= 8;
+  }
+  if (length > 0)
+  {
+    uint64_t chunk = 0;
+    std::memcpy(&chunk, bytes, length);
+    hash = mix(hash ^ chunk);
+  }
+  return hash;
+}
+
+BlockedBloomFilter::BlockedBloomFilter(uint64_t capacity, double bitsPerKey)
+    : keyCapacity(capacity),
+      blockCount(std::min(MAX_BLOCKS, std::max<uint64_t>(1, std::ceil(capacity * bitsPerKey / 512)))),
+      blocks(new Block[blockCount]())
+{
+}
+
+void BlockedBloomFilter::insert(uint64_t hash)
+{
+  auto &target = blocks[blockOf(hash)];
+  uint32_t low = static_cast<uint32_t>(hash);
+  for (int i = 0; i < 8; ++i)
+    target.words[i].fetch_or(1ULL << ((low * SALT[i]) >> 26), std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BlockedBloomFilter::contains(uint64_t hash) const
+{
+  const auto &target = blocks[blockOf(hash)];
+  uint32_t low = static_cast<uint32_t>(hash);
+  for (int i = 0; i < 8; ++i)
+  {
+    if (!(target.words[i].load(std::memory_order_relaxed) >> ((low * SALT[i]) >> 26) & 1))
+      return false;
+  }
+  return true;
+}
+
+double BlockedBloomFilter::falsePositiveRate() const
+{
+  // 없는 키가 통과하려면 고른 블록의 워드 8개에서 모두 세워진 비트를 만나야 한다
+  double sum = 0;
+  for (uint64_t i = 0; i < blockCount; ++i)
+  {
+    double rate = 1;
+    for (const auto &word : blocks[i].words)
+      rate *= __builtin_popcountll(word.load(std::memory_order_relaxed)) / 64.0;
+    sum += rate;
+  }
+  return sum / blockCount;
+}
@@ -0,0 +1,43 @@
+#ifndef BLOOMFILTER_HPP
+#define BLOOMFILTER_HPP
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+uint64_t bloomHash(const void *data, size_t length);
+
+/*
+ * cache line(512bit) 단위 blocked bloom filter.
+ * 해시 상위 32bit 로 블록 하나를 고르고, 하위 32bit 로 블록의 64bit 워드 8개에 한 비트씩 세운다.
+ * 조회 한 번에 cache miss 가 한 번뿐이고, 추가는 원자적 OR 라 조회와 동시에 할 수 있다.
+ */
+class BlockedBloomFilter
+{
+public:
+  BlockedBloomFilter(uint64_t capacity, double bitsPerKey);
+
+  void insert(uint64_t hash);
+  bool contains(uint64_t hash) const;
+
+  uint64_t capacity() const { return keyCapacity; }
+  uint64_t size() const { return count.load(std::memory_order_relaxed); }
+  size_t bytes() const { return blockCount * sizeof(Block); }
+  // 블록별로 세워진 비트 비율로 계산한 오탐률 (전체를 훑는다)
+  double falsePositiveRate() const;
+
+private:
+  struct alignas(64) Block
+  {
+    std::atomic<uint64_t> words[8];
+  };
+
+  uint64_t keyCapacity;
+  uint64_t blockCount;
+  std::unique_ptr<Block[]> blocks;
+  std::atomic<uint64_t> count{0};
+
+  uint64_t blockOf(uint64_t hash) const { return ((hash >> 32) * blockCount) >> 32; }
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "ChainLock.hpp"
+
+#include <mutex>
+
+ChainLock &ChainLock::Instance()
+{
+  static ChainLock lock;
+  return lock;
+}
+
+void ChainLock::reload(blocksci::Blockchain &chain)
+{
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  chain.reload();
+  ++current;
+}
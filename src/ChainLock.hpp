@@ -0,0 +1,29 @@
+#ifndef CHAINLOCK_HPP
+#define CHAINLOCK_HPP
+#include <blocksci/blocksci.hpp>
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+
+/*
+ * BlockSci 체인 reload 와 체인 읽기의 동기화 (프로세스 전역).
+ * Blockchain::reload() 는 데이터 파일을 다시 매핑하므로, 요청 처리와 인덱스 갱신처럼
+ * 체인을 읽는 쪽은 read() 를 잡고 reload 는 그것이 모두 풀린 뒤에 한다.
+ * 체인에서 계산해 캐시한 값은 generation() 이 바뀌면 버린다.
+ */
+class ChainLock
+{
+public:
+  static ChainLock &Instance();
+
+  std::shared_lock<std::shared_mutex> read() { return std::shared_lock<std::shared_mutex>(mutex); }
+  // 새 블록을 보이게 하고 generation 을 올린다
+  void reload(blocksci::Blockchain &chain);
+  uint64_t generation() const { return current.load(); }
+
+private:
+  std::shared_mutex mutex;
+  std::atomic<uint64_t> current{0};
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "ChangeHeuristic.hpp"
+
+ChangeHeuristic::ChangeHeuristic() : powerOfTenChange(6) {} // `6`은 10의 거듭제곱의 자릿수를 나타냅니다.
+
+namespace
+{
+    template <class Outputs>
+    void addScore(std::vector<int> &outputScores, const Outputs &outputs, int score)
+    {
+        for (const auto &item : outputs) {
+            if (item.outputIndex() < outputScores.size())
+                outputScores[item.outputIndex()] += score;
+        }
+    }
+}
+
+std::vector<int> ChangeHeuristic::scoreOutputs(const blocksci::Transaction &tx)
+{
+    std::vector<int> outputScores(tx.outputCount(), 0);
+
+    addScore(outputScores, addressReuseChange(tx), ADDRESS_REUSE_SCORE);
+    addScore(outputScores, peelingChainChange(tx), PEELING_CHAIN_SCORE);
+    addScore(outputScores, powerOfTenChange(tx), POWER_OF_TEN_SCORE);
+    addScore(outputScores, optimalChangeChange(tx), OPTIMAL_CHANGE_SCORE);
+    addScore(outputScores, addressTypeChange(tx), ADDRESS_TYPE_SCORE);
+    addScore(outputScores, locktimeChange(tx), LOCKTIME_SCORE);
+    addScore(outputScores, clientChangeBehaviorChange(tx), CLIENT_BEHAVIOR_SCORE);
+    addScore(outputScores, legacyChange(tx), LEGACY_SCORE);
+    addScore(outputScores, fixedFeeChange(tx), FIXED_FEE_SCORE);
+    addScore(outputScores, spentChange(tx), SPENT_SCORE);
+
+    return outputScores;
+}
+
+std::vector<blocksci::Output> ChangeHeuristic::nonChangeOutputs(const blocksci::Transaction &tx)
+{
+    auto outputScores = scoreOutputs(tx);
+    std::vector<blocksci::Output> noChangeOutputs;
+    noChangeOutputs.reserve(outputScores.size());
+
+    for (const auto &output : tx.outputs()) {
+        if (outputScores[output.outputIndex()] < THRESHOLD_SCORE) {
+            noChangeOutputs.push_back(output);
+        }
+    }
+    return noChangeOutputs;
+}
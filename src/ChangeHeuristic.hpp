@@ -0,0 +1,45 @@
+#ifndef CHANGEHEURISTIC_HPP
+#define CHANGEHEURISTIC_HPP
+#include <blocksci/blocksci.hpp>
+#include <vector>
+
+const int THRESHOLD_SCORE = 8;
+
+const int PEELING_CHAIN_SCORE = 3;
+const int POWER_OF_TEN_SCORE = 2;
+const int OPTIMAL_CHANGE_SCORE = 2;
+const int ADDRESS_TYPE_SCORE = 1;
+const int LOCKTIME_SCORE = 1;
+const int ADDRESS_REUSE_SCORE = 3;
+const int CLIENT_BEHAVIOR_SCORE = 2;
+const int LEGACY_SCORE = 1;
+const int FIXED_FEE_SCORE = 1;
+const int SPENT_SCORE = 1;
+
+/*
+ * BlockSci 잔돈 휴리스틱 점수 합산.
+ * 합계가 THRESHOLD_SCORE 미만인 출력을 실제 수령(잔돈 아님) 출력으로 본다.
+ */
+class ChangeHeuristic
+{
+public:
+    ChangeHeuristic();
+    // outputIndex 별 점수
+    std::vector<int> scoreOutputs(const blocksci::Transaction &tx);
+    // 출력 순서대로 반환
+    std::vector<blocksci::Output> nonChangeOutputs(const blocksci::Transaction &tx);
+
+private:
+    blocksci::heuristics::PeelingChainChange peelingChainChange;
+    blocksci::heuristics::PowerOfTenChange powerOfTenChange;
+    blocksci::heuristics::OptimalChangeChange optimalChangeChange;
+    blocksci::heuristics::AddressTypeChange addressTypeChange;
+    blocksci::heuristics::LocktimeChange locktimeChange;
+    blocksci::heuristics::AddressReuseChange addressReuseChange;
+    blocksci::heuristics::ClientChangeAddressBehaviorChange clientChangeBehaviorChange;
+    blocksci::heuristics::LegacyChange legacyChange;
+    blocksci::heuristics::FixedFee fixedFeeChange;
+    blocksci::heuristics::Spent spentChange;
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "ClusterIndex.hpp"
+#include "AddressEncoder.hpp"
+#include "ChainLock.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+  const uint64_t CLUSTER_INDEX_MAGIC = 0x58444e4943534242ULL; // "BBSCINDX"
+  const uint32_t CLUSTER_INDEX_VERSION = 2;
+  const size_t MIN_NODES = 1 << 16;
+
+  // BlockSci 가 같은 scriptNum 을 쓰는 타입은 한 노드로 (P2PK/P2PKH/P2WPKH, P2SH/P2WSH)
+  blocksci::AddressType::Enum dedupType(blocksci::AddressType::Enum type)
+  {
+    switch (type)
+    {
+    case blocksci::AddressType::PUBKEYHASH:
+    case blocksci::AddressType::WITNESS_PUBKEYHASH:
+    case blocksci::AddressType::MULTISIG_PUBKEY:
+      return blocksci::AddressType::PUBKEY;
+    case blocksci::AddressType::WITNESS_SCRIPTHASH:
+      return blocksci::AddressType::SCRIPTHASH;
+    default:
+      return type;
+    }
+  }
+
+  uint64_t clusterKey(const blocksci::Address &address)
+  {
+    return (static_cast<uint64_t>(dedupType(address.type)) + 1) << 32 | address.scriptNum;
+  }
+
+  int sizeBucket(uint64_t size)
+  {
+    return 63 - __builtin_clzll(size);
+  }
+}
+
+ClusterIndex::ClusterIndex(const std::string &directory, blocksci::Blockchain &chain, bool mergeChange)
+    : chain(chain), directory(directory), mergeChange(mergeChange)
+{
+  std::filesystem::create_directories(directory);
+  metaFile = MappedFile(directory + "/meta.dat", true);
+  if (metaFile.size() == 0)
+  {
+    metaFile.resize(sizeof(Meta));
+    meta().magic = CLUSTER_INDEX_MAGIC;
+    meta().version = CLUSTER_INDEX_VERSION;
+    meta().processedHeight = -1;
+    meta().mergeChange = mergeChange;
+    metaFile.sync();
+  }
+  else if (metaFile.size() != sizeof(Meta) || meta().magic != CLUSTER_INDEX_MAGIC ||
+           meta().version != CLUSTER_INDEX_VERSION)
+  {
+    throw std::runtime_error("Incompatible cluster index in " + directory);
+  }
+  else if (meta().mergeChange != static_cast<uint32_t>(mergeChange))
+  {
+    throw std::runtime_error("Cluster index in " + directory + " was built with a different change merge setting");
+  }
+
+  for (size_t i = 0; i < CLUSTER_TYPE_SLOTS; ++i)
+    files[i] = MappedFile(directory + "/nodes-" + std::to_string(i) + ".dat", true);
+  published = meta().processedHeight;
+}
+
+int ClusterIndex::update()
+{
+  int last = chain.size() - 1;
+  int height = processedHeight() + 1;
+  int processed = 0;
+
+  while (height <= last && !stopping)
+  {
+    int batchEnd = std::min(last, height + CLUSTER_BATCH_BLOCKS - 1);
+    // 배치 사이에는 체인 reload 가 끼어들 수 있다 (last 까지의 블록은 그대로다)
+    auto chainLock = ChainLock::Instance().read();
+    for (; height <= batchEnd && !stopping; ++height)
+    {
+      // 블록마다 잠가서 읽는 쪽이 배치 전체나 msync 를 기다리지 않게 한다
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      processBlock(chain[height]);
+      ++processed;
+    }
+    // 노드를 먼저 내려 쓴 뒤 높이를 기록해, 기록된 높이까지는 항상 디스크에 반영되어 있게 한다.
+    // 파일을 키우는 것은 이 스레드뿐이므로 잠그지 않고 sync 한다
+    sync();
+    {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      meta().processedHeight = height - 1;
+    }
+    metaFile.sync();
+    published = height - 1;
+  }
+  if (!stopping && height > last)
+    complete = true;
+  return processed;
+}
+
+int ClusterIndex::processedHeight() const
+{
+  return published;
+}
+
+uint64_t ClusterIndex::clusterSize(const blocksci::Address &address)
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  const Node *root = findNode(rootReadOnly(clusterKey(address)));
+  return root ? root->size + 1 : 1;
+}
+
+std::vector<blocksci::Address> ClusterIndex::members(const blocksci::Address &address, size_t limit)
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  std::vector<blocksci::Address> res;
+  uint64_t start = clusterKey(address);
+  uint64_t key = start;
+  do
+  {
+    // 노드마다 입력으로 쓰인 실제 타입의 주소를 펼친다. 조회한 주소는 항상 포함
+    const Node *current = findNode(key);
+    uint64_t types = current ? current->types : 0;
+    if (key == start)
+      types |= 1ULL << address.type;
+    if (types == 0)
+      res.push_back(addressFromKey(key, chain.getAccess()));
+    for (uint32_t type = 0; types && type < CLUSTER_TYPE_SLOTS && res.size() < limit; ++type)
+    {
+      if (types >> type & 1)
+        res.emplace_back(static_cast<uint32_t>(key), static_cast<blocksci::AddressType::Enum>(type), chain.getAccess());
+    }
+    // 병합 도중 중단되어 next 가 없거나 자기 자신이면 더 따라가지 않는다
+    if (!current || !current->next || current->next == key)
+      break;
+    key = current->next;
+  } while (key != start && res.size() < limit);
+  return res;
+}
+
+json ClusterIndex::sizeSnapshot()
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  const Meta &stats = meta();
+  json res;
+  res["processed_height"] = published.load();
+  res["caught_up"] = complete.load();
+  res["merge_change"] = stats.mergeChange != 0;
+  res["n_cluster"] = stats.clusterCount;
+  res["largest_size"] = stats.largestSize;
+  res["histogram"] = json::array();
+  for (int i = 0; i < 64; ++i)
+  {
+    if (stats.histogram[i] == 0)
+      continue;
+    json bucket;
+    bucket["min_size"] = 1ULL << i;
+    bucket["n_cluster"] = stats.histogram[i];
+    res["histogram"].push_back(std::move(bucket));
+  }
+  return res;
+}
+
+const ClusterIndex::Node *ClusterIndex::findNode(uint64_t key) const
+{
+  uint64_t type = (key >> 32) - 1;
+  uint32_t index = static_cast<uint32_t>(key);
+  if (type >= CLUSTER_TYPE_SLOTS || files[type].size() / sizeof(Node) <= index)
+    return nullptr;
+  return reinterpret_cast<const Node *>(files[type].data()) + index;
+}
+
+/* 쓰기용. 필요하면 파일을 키우므로 이전에 받은 Node 참조는 무효가 될 수 있다. */
+ClusterIndex::Node &ClusterIndex::node(uint64_t key)
+{
+  uint64_t type = (key >> 32) - 1;
+  uint32_t index = static_cast<uint32_t>(key);
+  if (type >= CLUSTER_TYPE_SLOTS)
+    throw std::runtime_error("Invalid address type in cluster index");
+  auto &file = files[type];
+  size_t capacity = file.size() / sizeof(Node);
+  if (index >= capacity)
+  {
+    size_t grown = std::max({static_cast<size_t>(index) + 1, capacity + capacity / 2, MIN_NODES});
+    file.resize(grown * sizeof(Node));
+  }
+  return reinterpret_cast<Node *>(file.data())[index];
+}
+
+uint64_t ClusterIndex::parentOf(uint64_t key) const
+{
+  const Node *current = findNode(key);
+  return (current && current->parent) ? current->parent : key;
+}
+
+uint64_t ClusterIndex::root(uint64_t key)
+{
+  // path halving
+  for (;;)
+  {
+    uint64_t parent = node(key).parent;
+    if (!parent)
+      return key;
+    uint64_t grandParent = node(parent).parent;
+    if (grandParent)
+      node(key).parent = grandParent;
+    key = node(key).parent;
+  }
+}
+
+uint64_t ClusterIndex::rootReadOnly(uint64_t key) const
+{
+  for (uint64_t parent = parentOf(key); parent != key; parent = parentOf(key))
+    key = parent;
+  return key;
+}
+
+void ClusterIndex::unite(uint64_t a, uint64_t b)
+{
+  uint64_t rootA = root(a), rootB = root(b);
+  if (rootA == rootB)
+    return;
+
+  // 두 노드 모두 미리 확보한 뒤 참조를 잡는다
+  node(rootA);
+  node(rootB);
+  Node *nodeA = &node(rootA), *nodeB = &node(rootB);
+  uint64_t sizeA = nodeA->size + 1, sizeB = nodeB->size + 1;
+  if (sizeA < sizeB)
+  {
+    std::swap(rootA, rootB);
+    std::swap(nodeA, nodeB);
+    std::swap(sizeA, sizeB);
+  }
+
+  uint64_t nextA = nodeA->next ? nodeA->next : rootA;
+  uint64_t nextB = nodeB->next ? nodeB->next : rootB;
+  nodeA->next = nextB;
+  nodeB->next = nextA;
+  nodeB->parent = rootA;
+  uint64_t merged = sizeA + sizeB;
+  nodeA->size = merged - 1;
+
+  Meta &stats = meta();
+  if (sizeA >= 2)
+  {
+    --stats.histogram[sizeBucket(sizeA)];
+    --stats.clusterCount;
+  }
+  if (sizeB >= 2)
+  {
+    --stats.histogram[sizeBucket(sizeB)];
+    --stats.clusterCount;
+  }
+  ++stats.histogram[sizeBucket(merged)];
+  ++stats.clusterCount;
+  if (merged > stats.largestSize)
+  {
+    stats.largestSize = merged;
+    stats.largestRoot = rootA;
+  }
+}
+
+void ClusterIndex::processBlock(const blocksci::Block &block)
+{
+  std::vector<uint64_t> keys;
+  auto mark = [this](const blocksci::Address &address)
+  {
+    uint64_t key = clusterKey(address);
+    node(key).types |= 1ULL << address.type;
+    return key;
+  };
+  for (const auto &tx : block)
+  {
+    if (tx.isCoinbase() || blocksci::heuristics::isCoinjoin(tx))
+      continue;
+
+    keys.clear();
+    for (const auto &input : tx.inputs())
+    {
+      auto address = input.getAddress();
+      if (address.type != blocksci::AddressType::NULL_DATA)
+        keys.push_back(mark(address));
+    }
+    if (keys.empty())
+      continue;
+
+    // 잔돈으로 판정된 출력이 정확히 하나일 때만 입력 클러스터에 합친다
+    if (mergeChange)
+    {
+      auto scores = heuristic.scoreOutputs(tx);
+      std::optional<blocksci::Address> change;
+      int changeCount = 0;
+      for (const auto &output : tx.outputs())
+      {
+        if (scores[output.outputIndex()] >= THRESHOLD_SCORE)
+        {
+          ++changeCount;
+          change = output.getAddress();
+        }
+      }
+      if (changeCount == 1)
+        keys.push_back(mark(*change));
+    }
+
+    for (size_t i = 1; i < keys.size(); ++i)
+      unite(keys[0], keys[i]);
+  }
+}
+
+void ClusterIndex::sync()
+{
+  for (auto &file : files)
+    file.sync();
+}
@@ -0,0 +1,91 @@
+#ifndef CLUSTERINDEX_HPP
+#define CLUSTERINDEX_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "ChangeHeuristic.hpp"
+#include "MappedFile.hpp"
+
+using json = nlohmann::json;
+
+const size_t CLUSTER_TYPE_SLOTS = 16;  // AddressType::Enum 값별 파일
+const int CLUSTER_BATCH_BLOCKS = 100;  // 이 블록 수마다 처리 높이를 기록하고 flush
+const size_t CLUSTER_MEMBER_LIMIT = 1000000; // members() 로 돌려주는 최대 주소 수
+
+/*
+ * 블록 단위로 갱신되는 영속 union-find (multi-input 휴리스틱).
+ * 주소 타입별 파일을 mmap 해서 노드를 (type, scriptNum) 로 직접 찾는다.
+ * BlockSci 의 ClusterManager 처럼 scriptNum 을 공유하는 타입(P2PK/P2PKH/P2WPKH, P2SH/P2WSH)은
+ * 대표 타입(PUBKEY, SCRIPTHASH)의 노드 하나로 묶는다.
+ * 파일은 0 으로 채워지며 0 은 "자기 자신"(parent, next) / 크기 1 을 뜻한다.
+ * 같은 union 을 다시 적용해도 결과가 같으므로, 중단 후에는 마지막으로
+ * 기록된 높이 다음 블록부터 다시 처리하면 된다.
+ */
+class ClusterIndex
+{
+public:
+  ClusterIndex(const std::string &directory, blocksci::Blockchain &chain, bool mergeChange);
+
+  // chain 의 마지막 블록까지 반영하고 처리한 블록 수를 반환
+  int update();
+  void stop() { stopping = true; }
+
+  // 디스크에 기록된 처리 높이. 그 뒤 블록의 병합도 일부 보일 수 있다 (병합은 되돌려지지 않는다)
+  int processedHeight() const;
+  // 체인 끝까지 한 번 따라잡았는지. 그 전의 클러스터는 일부 블록만 반영된 것이다
+  bool caughtUp() const { return complete; }
+  uint64_t clusterSize(const blocksci::Address &address);
+  // 같은 클러스터의 주소 목록 (limit 개까지). 원형 리스트가 끊겨 있으면 끊긴 곳까지만
+  std::vector<blocksci::Address> members(const blocksci::Address &address, size_t limit);
+  json sizeSnapshot();
+
+private:
+  struct Node
+  {
+    uint64_t parent; // 0 이면 루트
+    uint64_t next;   // 클러스터 원형 연결 리스트, 0 이면 자기 자신
+    uint64_t size;   // 루트에서만 유효, 실제 크기 - 1
+    uint64_t types;  // 이 노드의 scriptNum 으로 입력에 쓰인 AddressType 비트
+  };
+
+  struct Meta
+  {
+    uint64_t magic;
+    uint32_t version;
+    int32_t processedHeight;
+    uint32_t mergeChange;
+    uint32_t reserved;
+    uint64_t clusterCount; // 크기 2 이상인 클러스터 수
+    uint64_t largestRoot;
+    uint64_t largestSize;
+    uint64_t histogram[64]; // log2(size) 별 클러스터 수 (크기 2 이상)
+  };
+
+  blocksci::Blockchain &chain;
+  std::string directory;
+  bool mergeChange;
+  std::array<MappedFile, CLUSTER_TYPE_SLOTS> files;
+  MappedFile metaFile;
+  mutable std::shared_mutex mutex;
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> complete{false};
+  std::atomic<int> published{-1}; // meta().processedHeight 를 잠그지 않고 읽기 위한 사본
+  ChangeHeuristic heuristic;
+
+  Meta &meta() { return *reinterpret_cast<Meta *>(metaFile.data()); }
+  const Node *findNode(uint64_t key) const;
+  Node &node(uint64_t key);
+  uint64_t parentOf(uint64_t key) const;
+  uint64_t root(uint64_t key);
+  uint64_t rootReadOnly(uint64_t key) const;
+  void unite(uint64_t a, uint64_t b);
+  void processBlock(const blocksci::Block &block);
+  // 노드 파일만 flush. 메타는 노드가 내려간 뒤에 따로 쓴다
+  void sync();
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "Compression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+  const size_t CHUNK_SIZE = 64 * 1024;
+
+  std::string trim(const std::string &value)
+  {
+    auto first = value.find_first_not_of(" \t");
+    if (first == std::string::npos)
+      return "";
+    auto last = value.find_last_not_of(" \t");
+    return value.substr(first, last - first + 1);
+  }
+
+  // 같은 q 값일 때의 선호 순서
+  int rank(ContentEncoding encoding)
+  {
+    switch (encoding)
+    {
+    case ContentEncoding::Zstd:
+      return 3;
+    case ContentEncoding::Gzip:
+      return 2;
+    case ContentEncoding::Deflate:
+      return 1;
+    default:
+      return 0;
+    }
+  }
+}
+
+int CompressionConfig::levelFor(const utility::string_t &path) const
+{
+  auto find = routeLevels.find(path);
+  return find == routeLevels.end() ? level : find->second;
+}
+
+ContentEncoding Compression::negotiate(const utility::string_t &acceptEncoding)
+{
+  std::string header = utility::conversions::to_utf8string(acceptEncoding);
+  ContentEncoding best = ContentEncoding::Identity;
+  double bestQuality = 0.0;
+  size_t start = 0;
+
+  while (start <= header.size())
+  {
+    size_t end = header.find(',', start);
+    if (end == std::string::npos)
+      end = header.size();
+    std::string item = header.substr(start, end - start);
+    start = end + 1;
+
+    double quality = 1.0;
+    size_t params = item.find(';');
+    std::string coding = trim(item.substr(0, params));
+    std::transform(coding.begin(), coding.end(), coding.begin(), ::tolower);
+    if (params != std::string::npos)
+    {
+      size_t q = item.find("q=", params);
+      if (q != std::string::npos)
+        quality = std::atof(item.c_str() + q + 2);
+    }
+    if (quality <= 0.0)
+      continue;
+
+    ContentEncoding encoding;
+    if (coding == "zstd")
+      encoding = ContentEncoding::Zstd;
+    else if (coding == "gzip" || coding == "x-gzip")
+      encoding = ContentEncoding::Gzip;
+    else if (coding == "deflate")
+      encoding = ContentEncoding::Deflate;
+    else
+      continue;
+
+    if (quality > bestQuality || (quality == bestQuality && rank(encoding) > rank(best)))
+    {
+      best = encoding;
+      bestQuality = quality;
+    }
+  }
+  return best;
+}
+
+const char *Compression::name(ContentEncoding encoding)
+{
+  switch (encoding)
+  {
+  case ContentEncoding::Gzip:
+    return "gzip";
+  case ContentEncoding::Deflate:
+    return "deflate";
+  case ContentEncoding::Zstd:
+    return "zstd";
+  default:
+    return "identity";
+  }
+}
+
+CompressingStreamBuf::CompressingStreamBuf(ContentEncoding encoding, int level, size_t minSize)
+    : requested(encoding), level(level), minSize(minSize), chunk(CHUNK_SIZE)
+{
+  setp(chunk.data(), chunk.data() + chunk.size());
+}
+
+CompressingStreamBuf::~CompressingStreamBuf()
+{
+  if (!compressing)
+    return;
+  if (requested == ContentEncoding::Zstd)
+    ZSTD_freeCCtx(zstdContext);
+  else
+    deflateEnd(&zstream);
+}
+
+std::vector<unsigned char> CompressingStreamBuf::finish()
+{
+  if (!finished)
+  {
+    flushChunk();
+    if (compressing)
+      compress(nullptr, 0, true);
+    finished = true;
+  }
+  return std::move(body);
+}
+
+CompressingStreamBuf::int_type CompressingStreamBuf::overflow(int_type ch)
+{
+  flushChunk();
+  if (traits_type::eq_int_type(ch, traits_type::eof()))
+    return traits_type::not_eof(ch);
+  *pptr() = traits_type::to_char_type(ch);
+  pbump(1);
+  return ch;
+}
+
+int CompressingStreamBuf::sync()
+{
+  flushChunk();
+  return 0;
+}
+
+void CompressingStreamBuf::flushChunk()
+{
+  size_t length = pptr() - pbase();
+  if (length > 0)
+    consume(reinterpret_cast<const unsigned char *>(pbase()), length);
+  setp(chunk.data(), chunk.data() + chunk.size());
+}
+
+void CompressingStreamBuf::consume(const unsigned char *data, size_t length)
+{
+  if (finished)
+    throw std::runtime_error("Write after compressed body was finished");
+  rawSize += length;
+  if (compressing)
+  {
+    compress(data, length, false);
+    return;
+  }
+  body.insert(body.end(), data, data + length);
+  if (requested != ContentEncoding::Identity && body.size() >= minSize)
+    startCompression();
+}
+
+void CompressingStreamBuf::startCompression()
+{
+  if (requested == ContentEncoding::Zstd)
+  {
+    zstdContext = ZSTD_createCCtx();
+    if (!zstdContext)
+      throw std::runtime_error("Failed to create zstd context");
+    ZSTD_CCtx_setParameter(zstdContext, ZSTD_c_compressionLevel, std::clamp(level, 1, ZSTD_maxCLevel()));
+  }
+  else
+  {
+    int windowBits = requested == ContentEncoding::Gzip ? MAX_WBITS + 16 : MAX_WBITS;
+    if (deflateInit2(&zstream, std::clamp(level, 1, 9), Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("Failed to initialize zlib stream");
+  }
+  compressing = true;
+
+  std::vector<unsigned char> pending;
+  pending.swap(body);
+  body.reserve(pending.size() / 4);
+  compress(pending.data(), pending.size(), false);
+}
+
+void CompressingStreamBuf::compress(const unsigned char *data, size_t length, bool last)
+{
+  if (requested == ContentEncoding::Zstd)
+  {
+    ZSTD_inBuffer input{data, length, 0};
+    ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+    bool done;
+    do
+    {
+      size_t offset = body.size();
+      body.resize(offset + CHUNK_SIZE);
+      ZSTD_outBuffer output{body.data() + offset, CHUNK_SIZE, 0};
+      size_t remaining = ZSTD_compressStream2(zstdContext, &output, &input, mode);
+      if (ZSTD_isError(remaining))
+        throw std::runtime_error(ZSTD_getErrorName(remaining));
+      body.resize(offset + output.pos);
+      done = last ? remaining == 0 : input.pos == input.size;
+    } while (!done);
+    return;
+  }
+
+  zstream.next_in = const_cast<Bytef *>(data);
+  zstream.avail_in = static_cast<uInt>(length);
+  int flush = last ? Z_FINISH : Z_NO_FLUSH;
+  do
+  {
+    size_t offset = body.size();
+    body.resize(offset + CHUNK_SIZE);
+    zstream.next_out = body.data() + offset;
+    zstream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+    if (deflate(&zstream, flush) == Z_STREAM_ERROR)
+      throw std::runtime_error("zlib compression failed");
+    body.resize(offset + CHUNK_SIZE - zstream.avail_out);
+  } while (zstream.avail_out == 0);
+}
@@ -0,0 +1,77 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+#include <cpprest/http_listener.h>
+#include <zlib.h>
+#include <zstd.h>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+enum class ContentEncoding
+{
+  Identity,
+  Gzip,
+  Deflate,
+  Zstd
+};
+
+struct CompressionConfig
+{
+  bool enabled = true;
+  size_t minSize = 16 * 1024;
+  int level = 6;
+  std::map<utility::string_t, int> routeLevels;
+
+  int levelFor(const utility::string_t &path) const;
+};
+
+class Compression
+{
+public:
+  static ContentEncoding negotiate(const utility::string_t &acceptEncoding);
+  static const char *name(ContentEncoding encoding);
+};
+
+/*
+ * 직렬화 결과를 받아 minSize 이하이면 그대로 보관하고,
+ * minSize 를 넘는 순간부터 스트리밍 압축으로 전환하는 streambuf.
+ * 원본 응답 전체를 메모리에 두 번 들고 있지 않는다.
+ */
+class CompressingStreamBuf : public std::streambuf
+{
+public:
+  CompressingStreamBuf(ContentEncoding encoding, int level, size_t minSize);
+  ~CompressingStreamBuf();
+  CompressingStreamBuf(const CompressingStreamBuf &) = delete;
+  CompressingStreamBuf &operator=(const CompressingStreamBuf &) = delete;
+
+  // 남은 데이터를 flush 하고 최종 body 를 반환
+  std::vector<unsigned char> finish();
+  // 실제로 적용된 인코딩 (minSize 미만이면 Identity)
+  ContentEncoding encoding() const { return compressing ? requested : ContentEncoding::Identity; }
+  size_t rawBytes() const { return rawSize; }
+
+protected:
+  int_type overflow(int_type ch) override;
+  int sync() override;
+
+private:
+  ContentEncoding requested;
+  int level;
+  size_t minSize;
+  bool compressing = false;
+  bool finished = false;
+  size_t rawSize = 0;
+  std::vector<char> chunk;
+  std::vector<unsigned char> body;
+  z_stream zstream{};
+  ZSTD_CCtx *zstdContext = nullptr;
+
+  void flushChunk();
+  void consume(const unsigned char *data, size_t length);
+  void startCompression();
+  void compress(const unsigned char *data, size_t length, bool last);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "Counterparties.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  const double MAX_LOAD_FACTOR = 0.7;
+
+  size_t slotFor(uint64_t key, size_t mask)
+  {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 17) & mask;
+  }
+}
+
+CounterpartyTable::CounterpartyTable(size_t expected)
+{
+  size_t capacity = 16;
+  while (capacity * MAX_LOAD_FACTOR < expected)
+    capacity <<= 1;
+  slots.resize(capacity);
+  mask = capacity - 1;
+}
+
+void CounterpartyTable::add(uint64_t key, int64_t value, uint32_t count)
+{
+  if (used + 1 > slots.size() * MAX_LOAD_FACTOR)
+    grow();
+  for (size_t i = slotFor(key, mask);; i = (i + 1) & mask)
+  {
+    auto &slot = slots[i];
+    if (slot.key == key)
+    {
+      slot.value += value;
+      slot.count += count;
+      return;
+    }
+    if (slot.key == 0)
+    {
+      slot = {key, value, count};
+      ++used;
+      return;
+    }
+  }
+}
+
+void CounterpartyTable::merge(const CounterpartyTable &other)
+{
+  for (const auto &slot : other.slots)
+  {
+    if (slot.key != 0)
+      add(slot.key, slot.value, slot.count);
+  }
+}
+
+std::vector<CounterpartyStat> CounterpartyTable::top(size_t k) const
+{
+  std::vector<CounterpartyStat> res;
+  res.reserve(used);
+  for (const auto &slot : slots)
+  {
+    if (slot.key != 0)
+      res.push_back(slot);
+  }
+  auto byValue = [](const CounterpartyStat &a, const CounterpartyStat &b)
+  { return a.value > b.value; };
+  if (k < res.size())
+  {
+    std::partial_sort(res.begin(), res.begin() + k, res.end(), byValue);
+    res.resize(k);
+  }
+  else
+  {
+    std::sort(res.begin(), res.end(), byValue);
+  }
+  return res;
+}
+
+void CounterpartyTable::grow()
+{
+  std::vector<CounterpartyStat> old(slots.size() * 2);
+  old.swap(slots);
+  mask = slots.size() - 1;
+  used = 0;
+  for (const auto &slot : old)
+  {
+    if (slot.key != 0)
+      add(slot.key, slot.value, slot.count);
+  }
+}
+
+CounterpartyAggregator::CounterpartyAggregator(const std::unordered_set<uint64_t> &members) : members(members) {}
+
+void CounterpartyAggregator::add(const blocksci::Transaction &tx)
+{
+  int64_t inputValue = 0, receivedValue = 0;
+  bool isSender = false;
+  ++n_tx;
+
+  for (const auto &input : tx.inputs())
+  {
+    inputValue += input.getValue();
+    if (isMember(input.getAddress()))
+      isSender = true;
+  }
+  for (const auto &output : tx.outputs())
+  {
+    if (isMember(output.getAddress()))
+      receivedValue += output.getValue();
+  }
+
+  if (isSender)
+  {
+    for (const auto &output : heuristic.nonChangeOutputs(tx))
+    {
+      auto recipient = output.getAddress();
+      if (!isMember(recipient))
+        sent.add(addressKey(recipient), output.getValue());
+    }
+  }
+
+  if (receivedValue > 0 && !isSender && !tx.isCoinbase() && inputValue > 0)
+  {
+    // 같은 거래에 여러 번 등장하는 입력 주소는 한 번만 센다
+    std::vector<std::pair<uint64_t, int64_t>> senders;
+    for (const auto &input : tx.inputs())
+    {
+      int64_t share = static_cast<int64_t>(static_cast<double>(receivedValue) * input.getValue() / inputValue);
+      senders.emplace_back(addressKey(input.getAddress()), share);
+    }
+    std::sort(senders.begin(), senders.end());
+    for (size_t i = 0; i < senders.size();)
+    {
+      uint64_t key = senders[i].first;
+      int64_t value = 0;
+      for (; i < senders.size() && senders[i].first == key; ++i)
+        value += senders[i].second;
+      received.add(key, value);
+    }
+  }
+}
+
+void CounterpartyAggregator::merge(const CounterpartyAggregator &other)
+{
+  sent.merge(other.sent);
+  received.merge(other.received);
+  n_tx += other.n_tx;
+}
@@ -0,0 +1,64 @@
+#ifndef COUNTERPARTIES_HPP
+#define COUNTERPARTIES_HPP
+#include <blocksci/blocksci.hpp>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include "AddressEncoder.hpp"
+#include "ChangeHeuristic.hpp"
+
+const size_t MAX_COUNTERPARTIES = 1000;
+const size_t COUNTERPARTY_PARALLEL_TXS = 4096; // 이 이상이면 거래 목록을 나눠 병렬 집계
+const size_t ROLLUP_CANDIDATE_FACTOR = 4;      // 클러스터 묶음 시 Mongo 조회할 후보 수 = k * factor, 넘으면 approximate
+
+struct CounterpartyStat
+{
+  uint64_t key = 0; // addressKey(), 0 은 빈 슬롯
+  int64_t value = 0;
+  uint32_t count = 0;
+};
+
+/* addressKey 를 키로 하는 open addressing (linear probing) 집계 테이블 */
+class CounterpartyTable
+{
+public:
+  explicit CounterpartyTable(size_t expected = 64);
+  void add(uint64_t key, int64_t value, uint32_t count = 1);
+  void merge(const CounterpartyTable &other);
+  // value 내림차순 상위 k 개
+  std::vector<CounterpartyStat> top(size_t k) const;
+  size_t size() const { return used; }
+
+private:
+  std::vector<CounterpartyStat> slots;
+  size_t used = 0;
+  size_t mask;
+
+  void grow();
+};
+
+/*
+ * 주소(또는 클러스터 주소 묶음)의 거래를 한 번 순회하며 송금 상대(잔돈이 아닌 수령 출력)와
+ * 입금 상대(입력 주소, 받은 금액을 입력 금액 비율로 배분)를 집계한다.
+ * members 끼리 오간 금액은 상대로 세지 않는다.
+ */
+class CounterpartyAggregator
+{
+public:
+  // members 는 addressKey 집합이며 집계하는 동안 살아 있어야 한다
+  CounterpartyAggregator(const std::unordered_set<uint64_t> &members);
+  void add(const blocksci::Transaction &tx);
+  void merge(const CounterpartyAggregator &other);
+
+  CounterpartyTable sent;
+  CounterpartyTable received;
+  uint64_t n_tx = 0;
+
+private:
+  const std::unordered_set<uint64_t> &members;
+  ChangeHeuristic heuristic;
+
+  bool isMember(const blocksci::Address &address) const { return members.count(addressKey(address)) > 0; }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "GraphExport.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+  const uint64_t GRAPH_MAGIC = 0x4547444548504152ULL; // "RAPHEDGE"
+  const uint32_t GRAPH_VERSION = 1;
+
+  void writeVarint(std::string &out, uint64_t value)
+  {
+    while (value >= 0x80)
+    {
+      out.push_back(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+  }
+
+  void writeFile(const std::string &path, const std::string &data)
+  {
+    std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file)
+      throw std::runtime_error("Failed to write " + path);
+    std::filesystem::rename(path + ".tmp", path);
+  }
+}
+
+GraphExport::GraphExport(blocksci::Blockchain &chain, const std::string &directory)
+    : chain(chain), directory(directory), addressEncoder(chain)
+{
+  std::filesystem::create_directories(directory);
+  writeFile(directory + "/addresses_header.csv", "address:ID(Address),type\n");
+  writeFile(directory + "/edges_header.csv", ":START_ID(Address),:END_ID(Address),value:long,txid,block_height:int\n");
+}
+
+int GraphExport::run(blocksci::BlockHeight start, blocksci::BlockHeight end)
+{
+  if (start < 0 || end >= chain.size() || start > end)
+    throw std::invalid_argument("Invalid block height range");
+
+  auto &pool = ThreadPool::Instance();
+  std::vector<std::future<void>> futures;
+  int total = 0, skipped = 0;
+  for (blocksci::BlockHeight first = start; first <= end; first += GRAPH_CHUNK_BLOCKS)
+  {
+    blocksci::BlockHeight last = std::min(end, first + GRAPH_CHUNK_BLOCKS - 1);
+    ++total;
+    if (std::filesystem::exists(chunkPath("edges", first, last, "bin")))
+    {
+      ++skipped;
+      continue;
+    }
+    futures.push_back(pool.submit([this, first, last]
+    {
+      writeChunk(first, last, collect(first, last));
+      std::cout << "graph export: blocks " << first << "-" << last << " (" << ++done << " chunks)" << std::endl;
+    }));
+  }
+  std::cout << "graph export: " << total << " chunks, " << skipped << " already done" << std::endl;
+
+  for (auto &future : futures)
+    future.wait();
+  for (auto &future : futures)
+    future.get();
+  return done;
+}
+
+std::vector<GraphEdge> GraphExport::collect(blocksci::BlockHeight first, blocksci::BlockHeight last)
+{
+  std::vector<GraphEdge> edges;
+  ChangeHeuristic heuristic;
+  std::unordered_map<uint64_t, int64_t> senders; // addressKey -> 입력 합
+
+  for (blocksci::BlockHeight height = first; height <= last; ++height)
+  {
+    for (const auto &tx : chain[height])
+    {
+      // CoinJoin 은 입력과 출력 주인이 여럿이라 비율로 나눈 송금 간선이 의미가 없다
+      if (tx.isCoinbase() || blocksci::heuristics::isCoinjoin(tx))
+        continue;
+
+      // 같은 주소의 입력은 합친다
+      senders.clear();
+      int64_t inputValue = 0;
+      for (const auto &input : tx.inputs())
+      {
+        senders[addressKey(input.getAddress())] += input.getValue();
+        inputValue += input.getValue();
+      }
+      if (inputValue <= 0)
+        continue;
+
+      for (const auto &output : heuristic.nonChangeOutputs(tx))
+      {
+        uint64_t target = addressKey(output.getAddress());
+        for (const auto &sender : senders)
+        {
+          if (sender.first == target)
+            continue;
+          auto value = static_cast<int64_t>(static_cast<__int128>(output.getValue()) * sender.second / inputValue);
+          edges.push_back({sender.first, target, tx.txNum, height, value});
+        }
+      }
+    }
+  }
+
+  // 같은 거래 안의 같은 간선은 합친다
+  std::sort(edges.begin(), edges.end());
+  size_t size = 0;
+  for (size_t i = 0; i < edges.size(); ++i)
+  {
+    if (size > 0 && edges[size - 1].source == edges[i].source && edges[size - 1].target == edges[i].target &&
+        edges[size - 1].txNum == edges[i].txNum)
+      edges[size - 1].value += edges[i].value;
+    else
+      edges[size++] = edges[i];
+  }
+  edges.resize(size);
+  return edges;
+}
+
+void GraphExport::writeChunk(blocksci::BlockHeight first, blocksci::BlockHeight last, const std::vector<GraphEdge> &edges)
+{
+  auto &access = chain.getAccess();
+  std::string binaryPath = chunkPath("edges", first, last, "bin");
+  std::string addressPath = chunkPath("addresses", first, last, "csv");
+  std::string edgePath = chunkPath("edges", first, last, "csv");
+  std::ofstream binary(binaryPath + ".tmp", std::ios::binary | std::ios::trunc);
+  std::ofstream addressCsv(addressPath + ".tmp", std::ios::trunc);
+  std::ofstream edgeCsv(edgePath + ".tmp", std::ios::trunc);
+
+  // 헤더: magic, version, first, last, count. 이후 간선마다
+  // source delta, (source 가 같으면 target delta 아니면 target), txNum, value 를 varint 로
+  uint64_t count = edges.size();
+  binary.write(reinterpret_cast<const char *>(&GRAPH_MAGIC), sizeof(GRAPH_MAGIC));
+  binary.write(reinterpret_cast<const char *>(&GRAPH_VERSION), sizeof(GRAPH_VERSION));
+  binary.write(reinterpret_cast<const char *>(&first), sizeof(first));
+  binary.write(reinterpret_cast<const char *>(&last), sizeof(last));
+  binary.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+  std::unordered_set<uint64_t> nodes;
+  std::unordered_map<uint32_t, std::string> txids;
+  std::string buffer;
+  uint64_t previousSource = 0, previousTarget = 0;
+  for (const auto &edge : edges)
+  {
+    buffer.clear();
+    writeVarint(buffer, edge.source - previousSource);
+    writeVarint(buffer, edge.source == previousSource ? edge.target - previousTarget : edge.target);
+    writeVarint(buffer, edge.txNum);
+    writeVarint(buffer, static_cast<uint64_t>(edge.value));
+    binary.write(buffer.data(), buffer.size());
+    previousSource = edge.source;
+    previousTarget = edge.target;
+
+    std::string source = addressEncoder.encode(addressFromKey(edge.source, access));
+    std::string target = addressEncoder.encode(addressFromKey(edge.target, access));
+    if (nodes.insert(edge.source).second)
+      addressCsv << source << ',' << addressTypeName(addressFromKey(edge.source, access).type) << '\n';
+    if (nodes.insert(edge.target).second)
+      addressCsv << target << ',' << addressTypeName(addressFromKey(edge.target, access).type) << '\n';
+
+    auto &txid = txids[edge.txNum];
+    if (txid.empty())
+      txid = blocksci::Transaction(edge.txNum, edge.height, access).getHash().GetHex();
+    edgeCsv << source << ',' << target << ',' << edge.value << ',' << txid << ',' << edge.height << '\n';
+  }
+
+  binary.close();
+  addressCsv.close();
+  edgeCsv.close();
+  if (!binary || !addressCsv || !edgeCsv)
+    throw std::runtime_error("Failed to write graph chunk " + std::to_string(first) + "-" + std::to_string(last));
+  std::filesystem::rename(addressPath + ".tmp", addressPath);
+  std::filesystem::rename(edgePath + ".tmp", edgePath);
+  std::filesystem::rename(binaryPath + ".tmp", binaryPath); // 완료 표시
+}
+
+std::string GraphExport::chunkPath(const std::string &name, blocksci::BlockHeight first, blocksci::BlockHeight last,
+                                   const std::string &extension) const
+{
+  return directory + "/" + name + "-" + std::to_string(first) + "-" + std::to_string(last) + "." + extension;
+}
@@ -0,0 +1,59 @@
+#ifndef GRAPHEXPORT_HPP
+#define GRAPHEXPORT_HPP
+#include <blocksci/blocksci.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AddressEncoder.hpp"
+#include "ChangeHeuristic.hpp"
+
+const int GRAPH_CHUNK_BLOCKS = 200;
+
+struct GraphEdge
+{
+  uint64_t source; // addressKey
+  uint64_t target; // addressKey
+  uint32_t txNum;
+  blocksci::BlockHeight height;
+  int64_t value;
+
+  bool operator<(const GraphEdge &other) const
+  {
+    if (source != other.source)
+      return source < other.source;
+    if (target != other.target)
+      return target < other.target;
+    return txNum < other.txNum;
+  }
+};
+
+/*
+ * 블록 구간의 주소 -> 주소 송금 그래프를 청크(GRAPH_CHUNK_BLOCKS 블록) 단위로 병렬 추출.
+ * 거래마다 입력 주소가 잔돈이 아닌 출력 주소로 보낸 값을 입력 금액 비율로 나눠 간선으로 만든다 (CoinJoin 제외).
+ * 청크마다
+ *  - edges-<first>-<last>.bin : (source, target, txNum) 정렬 후 delta + varint 로 압축한 간선
+ *  - addresses-<first>-<last>.csv, edges-<first>-<last>.csv : neo4j-admin import 용 (헤더는 별도 파일)
+ * 를 쓴다. 임시 파일에 쓴 뒤 rename 하고 .bin 이 마지막에 생기므로, 다시 실행하면 끝난 청크는 건너뛴다.
+ */
+class GraphExport
+{
+public:
+  GraphExport(blocksci::Blockchain &chain, const std::string &directory);
+
+  // 새로 내보낸 청크 수를 반환
+  int run(blocksci::BlockHeight start, blocksci::BlockHeight end);
+
+private:
+  blocksci::Blockchain &chain;
+  std::string directory;
+  AddressEncoder addressEncoder;
+  std::atomic<int> done{0};
+
+  std::vector<GraphEdge> collect(blocksci::BlockHeight first, blocksci::BlockHeight last);
+  void writeChunk(blocksci::BlockHeight first, blocksci::BlockHeight last, const std::vector<GraphEdge> &edges);
+  std::string chunkPath(const std::string &name, blocksci::BlockHeight first, blocksci::BlockHeight last,
+                        const std::string &extension) const;
+};
+
+#endif
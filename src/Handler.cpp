@@ -1,6 +1,80 @@
 #include "Handler.hpp"
+#include "AllocationCounter.hpp"
+#include "ChainLock.hpp"
 
+#include <algorithm>
+#include <ctime>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <unistd.h>
+#include <cpprest/producerconsumerstream.h>
+
+namespace
+{
+  utility::string_t queryValue(const std::map<utility::string_t, utility::string_t> &query_map,
+                               const utility::string_t &key, const utility::string_t &fallback)
+  {
+    auto find = query_map.find(key);
+    return find == query_map.end() ? fallback : find->second;
+  }
+
+  /*
+   * 숫자 파라미터 변환. 범위를 넘는 값의 out_of_range 도 invalid_argument 로 바꿔서
+   * 400 은 파라미터 오류에만, 그 밖의 logic_error 는 500 으로 가게 한다
+   */
+  std::invalid_argument invalidParameter(const utility::string_t &key)
+  {
+    return std::invalid_argument("Invalid " + utility::conversions::to_utf8string(key));
+  }
+
+  long long toLong(const utility::string_t &key, const utility::string_t &value)
+  {
+    try
+    {
+      return std::stoll(value);
+    }
+    catch (const std::logic_error &)
+    {
+      throw invalidParameter(key);
+    }
+  }
+
+  int toInt(const utility::string_t &key, const utility::string_t &value)
+  {
+    long long number = toLong(key, value);
+    if (number < std::numeric_limits<int>::min() || number > std::numeric_limits<int>::max())
+      throw invalidParameter(key);
+    return static_cast<int>(number);
+  }
+
+  // stoul 은 "-1" 을 ULONG_MAX 로 바꾸므로 음수를 먼저 거른다
+  size_t toUnsigned(const utility::string_t &key, const utility::string_t &value)
+  {
+    if (value.find(U('-')) != utility::string_t::npos)
+      throw invalidParameter(key);
+    try
+    {
+      return std::stoul(value);
+    }
+    catch (const std::logic_error &)
+    {
+      throw invalidParameter(key);
+    }
+  }
+
+  long long longValue(const std::map<utility::string_t, utility::string_t> &query_map,
+                      const utility::string_t &key, const utility::string_t &fallback)
+  {
+    return toLong(key, queryValue(query_map, key, fallback));
+  }
+
+  size_t unsignedValue(const std::map<utility::string_t, utility::string_t> &query_map,
+                       const utility::string_t &key, const utility::string_t &fallback)
+  {
+    return toUnsigned(key, queryValue(query_map, key, fallback));
+  }
+}
 
 // Handler::Handler(const utility::string_t &url, blocksci::Blockchain &chain)
 //     : http_listener(url), processApi(chain)
@@ -22,15 +96,124 @@ Handler::Handler(const utility::string_t &url, blocksci::Blockchain &chain,
   support(std::bind(&Handler::handle_request, this, std::placeholders::_1));
 }
 
+void Handler::setCompression(const CompressionConfig &config)
+{
+  compression = config;
+}
+
+void Handler::setOutputLimits(const OutputLimits &limits)
+{
+  outputLimits = limits;
+}
+
+/* 서버 기본값에 요청의 dust, top 을 덮어쓴다 (0 이면 끔) */
+OutputLimits Handler::outputLimitsFor(const std::map<utility::string_t, utility::string_t> &query_map) const
+{
+  OutputLimits limits = outputLimits;
+  if (query_map.count(U("dust")))
+    limits.dust = std::min<size_t>(unsignedValue(query_map, U("dust"), U("0")), std::numeric_limits<int64_t>::max());
+  if (query_map.count(U("top")))
+    limits.topOutputs = unsignedValue(query_map, U("top"), U("0"));
+  return limits;
+}
+
+void Handler::setClusterIndex(ClusterIndex *index)
+{
+  processApi.setClusterIndex(index);
+}
+
+void Handler::setSearchIndex(SearchIndex *index)
+{
+  processApi.setSearchIndex(index);
+}
+
+void Handler::setAddressFilter(const AddressFilter *filter)
+{
+  processApi.setAddressFilter(filter);
+  addressFilter = filter;
+}
+
+void Handler::setWarmUp(const WarmUp *warmUp)
+{
+  this->warmUp = warmUp;
+}
+
 /* GET Method 처리 */
 void Handler::handle_get(const http_request &request, const utility::string_t &path)
 {
-  json::value response;
+  nlohmann::json response;
   utility::string_t query_param;
-  std::string raw;
 
   auto query_map = uri::split_query(request.relative_uri().query());
 
+  if (path == U("/healthz"))
+  {
+    nlohmann::json res;
+    res["status"] = "ok";
+    res["pid"] = getpid();
+    reply(request, status_codes::OK, res);
+    return;
+  }
+  // 워밍업이 끝나기 전에는 503 으로 로드밸런서 투입을 늦춘다
+  if (path == U("/readyz"))
+  {
+    nlohmann::json res = warmUp ? warmUp->status() : nlohmann::json{{"ready", true}};
+    reply(request, res["ready"].get<bool>() ? status_codes::OK : status_codes::ServiceUnavailable, res);
+    return;
+  }
+  if (path == U("/metrics"))
+  {
+    nlohmann::json res = Metrics::Instance().toJson();
+    if (addressFilter)
+      res["address_filter"] = addressFilter->status();
+    reply(request, status_codes::OK, res);
+    return;
+  }
+  if (path == U("/heuristic/block"))
+  {
+    handle_block_scan(request, query_map);
+    return;
+  }
+  if (path == U("/search"))
+  {
+    try
+    {
+      auto prefix = query_map.find(U("prefix"));
+      if (prefix == query_map.end())
+      {
+        request.reply(status_codes::BadRequest, U("Query string not found."));
+        return;
+      }
+      size_t limit = unsignedValue(query_map, U("limit"), U("10"));
+      reply(request, status_codes::OK, processApi.search(prefix->second, limit));
+    }
+    catch(const std::invalid_argument& e)
+    {
+      request.reply(status_codes::BadRequest, U(e.what()));
+    }
+    catch(const std::runtime_error& e)
+    {
+      request.reply(status_codes::NotFound, U(e.what()));
+    }
+    catch(const std::exception& e)
+    {
+      request.reply(status_codes::InternalError, U(e.what()));
+    }
+    return;
+  }
+  if (path == U("/cluster/sizes"))
+  {
+    try
+    {
+      reply(request, status_codes::OK, processApi.getClusterSizes());
+    }
+    catch(const std::runtime_error& e)
+    {
+      request.reply(status_codes::NotFound, U(e.what()));
+    }
+    return;
+  }
+
   if (path == U("/info/addr"))
   {
     query_param = U("hash");
@@ -39,6 +222,10 @@ void Handler::handle_get(const http_request &request, const utility::string_t &p
   {
     query_param = U("hash");
   }
+  else if (path == U("/info/txid/outputs"))
+  {
+    query_param = U("hash");
+  }
   else if (path == U("/info/cluster"))
   {
     query_param = U("target");
@@ -51,6 +238,22 @@ void Handler::handle_get(const http_request &request, const utility::string_t &p
   {
     query_param = U("hash");
   } 
+  else if (path == U("/info/addr/history"))
+  {
+    query_param = query_map.count(U("cluster")) ? U("cluster") : U("hash");
+  }
+  else if (path == U("/info/addr/counterparties"))
+  {
+    query_param = query_map.count(U("cluster")) ? U("cluster") : U("hash");
+  }
+  else if (path == U("/analytics/range"))
+  {
+    query_param = U("start");
+  }
+  else if (path == U("/info/cluster/utxos"))
+  {
+    query_param = U("target");
+  }
   else
   {
     request.reply(status_codes::NotFound);
@@ -65,32 +268,72 @@ void Handler::handle_get(const http_request &request, const utility::string_t &p
     {
       if (path == U("/info/addr"))
       {
-        raw = processApi.getWalletData(value);
+        response = processApi.getWalletData(value);
       }
       else if (path == U("/info/txid"))
       {
-        raw = processApi.getTxData(value);
+        response = processApi.getTxData(value, outputLimitsFor(query_map));
+      }
+      else if (path == U("/info/txid/outputs"))
+      {
+        response = processApi.getTxOutputs(
+            value, outputLimitsFor(query_map).dust,
+            unsignedValue(query_map, U("offset"), U("0")),
+            unsignedValue(query_map, U("limit"), U("100")));
       }
       else if (path == U("/info/cluster"))
       {
-        raw = processApi.getClusterData(value);
+        response = processApi.getClusterData(value);
       }
       else if (path == U("/cluster"))
       {
-        raw = processApi.getClusterResult(value);
+        response = processApi.getClusterResult(value);
       }
       else if (path == U("/heuristic"))
       {
-        raw = processApi.getHeuristicResult(value);
+        response = processApi.getHeuristicResult(value);
+      }
+      else if (path == U("/info/addr/history"))
+      {
+        response = processApi.getBalanceHistory(
+            value, query_param == U("cluster"),
+            utility::conversions::to_utf8string(queryValue(query_map, U("bucket"), U("day"))),
+            longValue(query_map, U("start"), U("0")),
+            longValue(query_map, U("end"), U("0")));
+      }
+      else if (path == U("/info/addr/counterparties"))
+      {
+        response = processApi.getCounterparties(
+            value, query_param == U("cluster"), unsignedValue(query_map, U("k"), U("10")),
+            utility::conversions::to_utf8string(queryValue(query_map, U("direction"), U("both"))),
+            queryValue(query_map, U("rollup"), U("0")) == U("1"));
+      }
+      else if (path == U("/analytics/range"))
+      {
+        auto end = query_map.find(U("end"));
+        response = processApi.getRangeAnalytics(
+            toLong(U("start"), value), end == query_map.end() ? std::time(nullptr) : toLong(U("end"), end->second));
+      }
+      else if (path == U("/info/cluster/utxos"))
+      {
+        response = processApi.getClusterUtxos(
+            value, toInt(U("height"), queryValue(query_map, U("height"), U("-1"))),
+            unsignedValue(query_map, U("offset"), U("0")),
+            unsignedValue(query_map, U("limit"), U("100")));
       }
-      response = from_string(raw);
     }
     catch(const InvalidHash& e)
     {
       request.reply(status_codes::NotFound, U(e.what()));
       return;
     }
-    catch(const std::runtime_error& e)
+    // 잘못된 파라미터 (숫자 변환 실패 포함)
+    catch(const std::invalid_argument& e)
+    {
+      request.reply(status_codes::BadRequest, U(e.what()));
+      return;
+    }
+    catch(const std::exception& e)
     {
       request.reply(status_codes::InternalError, U(e.what()));
       return;
@@ -103,7 +346,63 @@ void Handler::handle_get(const http_request &request, const utility::string_t &p
     return;
   }
 
-  request.reply(status_codes::OK, response);
+  reply(request, status_codes::OK, response);
+}
+
+/* 블록 단위 휴리스틱 스캔. 거래별 결과를 NDJSON 으로 스트리밍 */
+void Handler::handle_block_scan(const http_request &request,
+                                const std::map<utility::string_t, utility::string_t> &query_map)
+{
+  blocksci::BlockHeight start, end;
+  try
+  {
+    auto height = query_map.find(U("height"));
+    if (height != query_map.end())
+    {
+      start = end = toInt(U("height"), height->second);
+    }
+    else if (query_map.count(U("start")) && query_map.count(U("end")))
+    {
+      start = toInt(U("start"), query_map.at(U("start")));
+      end = toInt(U("end"), query_map.at(U("end")));
+    }
+    else
+    {
+      request.reply(status_codes::BadRequest, U("Query string not found."));
+      return;
+    }
+    processApi.checkScanRange(start, end);
+  }
+  catch(const std::invalid_argument& e)
+  {
+    request.reply(status_codes::BadRequest, U(e.what()));
+    return;
+  }
+
+  concurrency::streams::producer_consumer_buffer<uint8_t> buffer;
+  http_response response(status_codes::OK);
+  response.set_body(buffer.create_istream(), U("application/x-ndjson"));
+  request.reply(response);
+
+  std::mutex writeMutex;
+  auto write = [&buffer, &writeMutex](const nlohmann::json &line)
+  {
+    std::string text = line.dump() + "\n";
+    std::lock_guard<std::mutex> lock(writeMutex);
+    buffer.putn_nocopy(reinterpret_cast<const uint8_t *>(text.data()), text.size()).wait();
+  };
+
+  try
+  {
+    write(processApi.scanHeuristics(start, end, write));
+  }
+  catch(const std::exception& e)
+  {
+    nlohmann::json error;
+    error["error"] = e.what();
+    write(error);
+  }
+  buffer.close(std::ios_base::out).wait();
 }
 
 /* POST Method 처리 */
@@ -135,15 +434,23 @@ void Handler::handle_post(const http_request &request,
                   {
                     return request.reply(status_codes::BadRequest, U("Missing or invalid 'end_date'."));
                   }
+                  // as_integer() 는 int 로 잘리므로 64bit 로 읽고 음수는 거절
+                  if (json_val.has_field(U("dust")) &&
+                      (!json_val[U("dust")].is_integer() || !json_val[U("dust")].as_number().is_int64() ||
+                       json_val[U("dust")].as_number().to_int64() < 0))
+                  {
+                    return request.reply(status_codes::BadRequest, U("Invalid 'dust'."));
+                  }
                   hash = json_val[U("hash")].as_string();
                   startDate = static_cast<time_t>(json_val[U("start_date")].as_integer());
                   endDate = static_cast<time_t>(json_val[U("end_date")].as_integer());
+                  int64_t dust = json_val.has_field(U("dust")) ? json_val[U("dust")].as_number().to_int64() : this->outputLimits.dust;
 
                   try 
                   {
-                    std::string raw = this->processApi.getTxInWallet(hash, startDate, endDate);
-                    json::value response = this->from_string(raw);
-                    return request.reply(status_codes::OK, response);
+                    auto chainLock = ChainLock::Instance().read();
+                    nlohmann::json response = this->processApi.getTxInWallet(hash, startDate, endDate, dust);
+                    return this->reply(request, status_codes::OK, response);
                   }
                   catch(const InvalidHash& e)
                   {
@@ -165,6 +472,9 @@ void Handler::handle_post(const http_request &request,
 void Handler::handle_request(http_request request)
 {
   utility::string_t path = request.relative_uri().path();
+  uint64_t allocations = threadAllocations();
+  // 처리하는 동안 체인 reload 를 막는다 (POST 는 본문을 받은 뒤 continuation 에서 따로 잡는다)
+  auto chainLock = ChainLock::Instance().read();
 
   if (request.method() == methods::GET)
   {
@@ -178,6 +488,50 @@ void Handler::handle_request(http_request request)
   {
     request.reply(status_codes::NotImplemented, U("Method not supported."));
   }
+
+  // TRACK_ALLOCATIONS 빌드에서만 의미 있음. 병렬 작업 스레드의 할당은 포함되지 않는다
+  if (allocationsTracked() && path != U("/metrics"))
+  {
+    auto &metrics = Metrics::Instance();
+    ++metrics.trackedRequests;
+    metrics.requestAllocations += threadAllocations() - allocations;
+  }
+}
+
+/* Accept 헤더에 따라 JSON / CBOR / MessagePack 으로, Accept-Encoding 에 따라 압축해서 응답 */
+pplx::task<void> Handler::reply(const http_request &request, status_code status, const nlohmann::json &body)
+{
+  ResponseFormat format = ResponseFormat::Json;
+  ContentEncoding encoding = ContentEncoding::Identity;
+  auto accept = request.headers().find(header_names::accept);
+  if (accept != request.headers().end())
+    format = ResponseEncoder::negotiate(accept->second);
+  auto acceptEncoding = request.headers().find(header_names::accept_encoding);
+  if (compression.enabled && acceptEncoding != request.headers().end())
+    encoding = Compression::negotiate(acceptEncoding->second);
+
+  CompressingStreamBuf buffer(encoding, compression.levelFor(request.relative_uri().path()), compression.minSize);
+  std::ostream out(&buffer);
+  ResponseEncoder::encode(body, format, out);
+  std::vector<unsigned char> data = buffer.finish();
+
+  auto &metrics = Metrics::Instance();
+  ++metrics.responses;
+  metrics.rawBytes += buffer.rawBytes();
+  metrics.sentBytes += data.size();
+
+  http_response response(status);
+  if (buffer.encoding() != ContentEncoding::Identity)
+  {
+    ++metrics.compressedResponses;
+    metrics.compressedRawBytes += buffer.rawBytes();
+    metrics.compressedSentBytes += data.size();
+    response.headers().add(header_names::content_encoding, U(Compression::name(buffer.encoding())));
+  }
+  response.set_body(std::move(data));
+  response.headers().set_content_type(U(ResponseEncoder::contentType(format)));
+  response.headers().add(header_names::vary, U("Accept, Accept-Encoding"));
+  return request.reply(response);
 }
 
 json::value Handler::from_string(const std::string &input)
@@ -2,6 +2,10 @@
 #define HANDLER_HPP
 
 #include "ProcessApi.hpp"
+#include "ResponseEncoder.hpp"
+#include "Compression.hpp"
+#include "Metrics.hpp"
+#include "WarmUp.hpp"
 
 using namespace web;
 using namespace web::http;
@@ -14,12 +18,26 @@ public:
         Handler(const utility::string_t &url, blocksci::Blockchain &chain, const std::string &mongoUri);
         Handler(const utility::string_t &url, blocksci::Blockchain &chain,
                 http_listener_config &config, const std::string &mongoUri);
+        void setCompression(const CompressionConfig &config);
+        void setOutputLimits(const OutputLimits &limits);
+        void setClusterIndex(ClusterIndex *index);
+        void setWarmUp(const WarmUp *warmUp);
+        void setSearchIndex(SearchIndex *index);
+        void setAddressFilter(const AddressFilter *filter);
 
 private:
         ProcessApi processApi;
+        CompressionConfig compression;
+        OutputLimits outputLimits;
+        const WarmUp *warmUp = nullptr;
+        const AddressFilter *addressFilter = nullptr;
         void handle_get(const http_request &request, const utility::string_t &path);
         void handle_post(const http_request &request, const utility::string_t &path);
         void handle_request(http_request request);
+        void handle_block_scan(const http_request &request,
+                               const std::map<utility::string_t, utility::string_t> &query_map);
+        OutputLimits outputLimitsFor(const std::map<utility::string_t, utility::string_t> &query_map) const;
+        pplx::task<void> reply(const http_request &request, status_code status, const nlohmann::json &body);
         json::value from_string(const std::string &input);
         json::value from_string_t(const utility::string_t &input);
 };
@@ -0,0 +1,102 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+  std::runtime_error systemError(const std::string &what, const std::string &path)
+  {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+  }
+}
+
+MappedFile::MappedFile(const std::string &path, bool writable) : path(path), writable(writable)
+{
+  fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (fd < 0)
+    throw systemError("Failed to open", path);
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    throw systemError("Failed to stat", path);
+  length = static_cast<size_t>(st.st_size);
+  map();
+}
+
+MappedFile::~MappedFile()
+{
+  unmap();
+  if (fd >= 0)
+    ::close(fd);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : path(std::move(other.path)), fd(std::exchange(other.fd, -1)), writable(other.writable),
+      address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+  if (this != &other)
+  {
+    unmap();
+    if (fd >= 0)
+      ::close(fd);
+    path = std::move(other.path);
+    fd = std::exchange(other.fd, -1);
+    writable = other.writable;
+    address = std::exchange(other.address, nullptr);
+    length = std::exchange(other.length, 0);
+  }
+  return *this;
+}
+
+void MappedFile::resize(size_t bytes)
+{
+  if (!writable)
+    throw std::runtime_error("Cannot resize read-only mapping " + path);
+  unmap();
+  if (ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+    throw systemError("Failed to resize", path);
+  length = bytes;
+  map();
+}
+
+void MappedFile::sync()
+{
+  if (address && writable)
+    msync(address, length, MS_SYNC);
+}
+
+void MappedFile::advise(int advice)
+{
+  if (address)
+    madvise(address, length, advice);
+}
+
+void MappedFile::map()
+{
+  if (length == 0)
+    return;
+  int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  address = mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED)
+  {
+    address = nullptr;
+    throw systemError("Failed to map", path);
+  }
+}
+
+void MappedFile::unmap()
+{
+  if (address)
+    munmap(address, length);
+  address = nullptr;
+}
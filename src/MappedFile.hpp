@@ -0,0 +1,39 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+#include <cstddef>
+#include <string>
+
+/* mmap 으로 연결한 파일. 쓰기 모드에서는 resize 로 파일을 키우고 다시 매핑한다. */
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  MappedFile(const std::string &path, bool writable);
+  ~MappedFile();
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  void resize(size_t bytes);
+  void sync();
+  void advise(int advice);
+
+  char *data() { return static_cast<char *>(address); }
+  const char *data() const { return static_cast<const char *>(address); }
+  size_t size() const { return length; }
+  bool isOpen() const { return fd >= 0; }
+  const std::string &getPath() const { return path; }
+
+private:
+  std::string path;
+  int fd = -1;
+  bool writable = false;
+  void *address = nullptr;
+  size_t length = 0;
+
+  void map();
+  void unmap();
+};
+
+#endif
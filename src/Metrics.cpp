@@ -0,0 +1,31 @@
+#include "Metrics.hpp"
+#include "AllocationCounter.hpp"
+
+Metrics &Metrics::Instance()
+{
+  static Metrics metrics;
+  return metrics;
+}
+
+json Metrics::toJson() const
+{
+  json res;
+  res["responses"] = responses.load();
+  res["raw_bytes"] = rawBytes.load();
+  res["sent_bytes"] = sentBytes.load();
+  res["compression"]["responses"] = compressedResponses.load();
+  res["compression"]["raw_bytes"] = compressedRawBytes.load();
+  res["compression"]["compressed_bytes"] = compressedSentBytes.load();
+  double heuristicSeconds = heuristicMicros.load() / 1e6;
+  res["heuristic_scan"]["n_tx"] = heuristicTxs.load();
+  res["heuristic_scan"]["seconds"] = heuristicSeconds;
+  res["heuristic_scan"]["tx_per_second"] = heuristicSeconds > 0 ? heuristicTxs.load() / heuristicSeconds : 0.0;
+  if (allocationsTracked())
+  {
+    uint64_t requests = trackedRequests.load();
+    res["allocations"]["requests"] = requests;
+    res["allocations"]["total"] = requestAllocations.load();
+    res["allocations"]["per_request"] = requests == 0 ? 0.0 : static_cast<double>(requestAllocations.load()) / requests;
+  }
+  return res;
+}
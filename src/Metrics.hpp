@@ -0,0 +1,28 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstdint>
+
+using json = nlohmann::json;
+
+/* 프로세스 전역 카운터. GET /metrics 로 노출된다. */
+class Metrics
+{
+public:
+  static Metrics &Instance();
+  json toJson() const;
+
+  std::atomic<uint64_t> responses{0};
+  std::atomic<uint64_t> compressedResponses{0};
+  std::atomic<uint64_t> rawBytes{0};
+  std::atomic<uint64_t> sentBytes{0};
+  std::atomic<uint64_t> compressedRawBytes{0};
+  std::atomic<uint64_t> compressedSentBytes{0};
+  std::atomic<uint64_t> heuristicTxs{0};
+  std::atomic<uint64_t> heuristicMicros{0};
+  std::atomic<uint64_t> trackedRequests{0};
+  std::atomic<uint64_t> requestAllocations{0};
+};
+
+#endif
@@ -64,6 +64,32 @@ json MongoDB::clusterFindByAddr(const std::string &addr)
   }
 }
 
+void MongoDB::labelledAddresses(const std::function<void(const std::string &)> &visit)
+{
+  mongocxx::options::find clusterOptions;
+  clusterOptions.projection(make_document(kvp("address", 1), kvp("_id", 0)));
+  for (const auto &doc : db["clusters"].find(make_document(), clusterOptions))
+  {
+    auto cluster = json::parse(bsoncxx::to_json(doc));
+    if (!cluster.contains("address") || !cluster["address"].is_array())
+      continue;
+    for (const auto &address : cluster["address"])
+    {
+      if (address.is_string())
+        visit(address.get<std::string>());
+    }
+  }
+
+  mongocxx::options::find profileOptions;
+  profileOptions.projection(make_document(kvp("target", 1), kvp("_id", 0)));
+  for (const auto &doc : db["profiles"].find(make_document(), profileOptions))
+  {
+    auto profile = json::parse(bsoncxx::to_json(doc));
+    if (profile.contains("target") && profile["target"].is_string())
+      visit(profile["target"].get<std::string>());
+  }
+}
+
 // void MongoDB::CreateIndexes() {
 //   auto result = walletCol.find_one({});
 //   if (result)
@@ -4,7 +4,9 @@
 #include <bsoncxx/json.hpp>
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/options/find.hpp>
 #include <nlohmann/json.hpp>
+#include <functional>
 #include <optional>
 
 using json = nlohmann::json;
@@ -18,6 +20,8 @@ public:
   std::optional<json> clusterFindById(const std::string &target);
   std::optional<json> clusterFindByName(const std::string &target);
   json clusterFindByAddr(const std::string &addr);
+  // 클러스터에 속했거나 프로필이 있는 주소(문자열)를 모두 방문
+  void labelledAddresses(const std::function<void(const std::string &)> &visit);
 
   // void CreateIndexes();
   // void UpdateHeight(int);
@@ -1,10 +1,53 @@
 #include "ProcessApi.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <unordered_set>
 
-ProcessApi::ProcessApi(blocksci::Blockchain &chain, const std::string &mongoUri) : chain(chain), mongoUri(mongoUri) {}
+namespace
+{
+    // 먼지 출력의 개수와 합계, 소비/미소비 구분
+    struct DustSummary
+    {
+        uint64_t count = 0, spentCount = 0;
+        int64_t value = 0, spentValue = 0;
+
+        void add(const blocksci::Output &output)
+        {
+            ++count;
+            value += output.getValue();
+            if (output.isSpent())
+            {
+                ++spentCount;
+                spentValue += output.getValue();
+            }
+        }
+
+        json toJson(int64_t threshold) const
+        {
+            json res;
+            res["threshold"] = threshold;
+            res["n_output"] = count;
+            res["value"] = value;
+            res["spent"] = {{"n_output", spentCount}, {"value", spentValue}};
+            res["unspent"] = {{"n_output", count - spentCount}, {"value", value - spentValue}};
+            return res;
+        }
+    };
 
-std::string ProcessApi::getTxData(const utility::string_t &req)
+    // 값 내림차순, 같으면 출력 번호 순
+    bool byValue(const blocksci::Output &a, const blocksci::Output &b)
+    {
+        int64_t left = a.getValue(), right = b.getValue();
+        return left != right ? left > right : a.outputIndex() < b.outputIndex();
+    }
+}
+
+ProcessApi::ProcessApi(blocksci::Blockchain &chain, const std::string &mongoUri) : chain(chain), mongoUri(mongoUri), addressEncoder(chain), rangeAnalytics(chain) {}
+
+json ProcessApi::getTxData(const utility::string_t &req, const OutputLimits &limits)
 {
     std::string hash = utility::conversions::to_utf8string(req);
     blocksci::Transaction tx;
@@ -39,29 +82,60 @@ std::string ProcessApi::getTxData(const utility::string_t &req)
         res["is_CoinJoin"] = blocksci::heuristics::isCoinjoin(tx);
 
         fee = inputValue = outputValue = 0;
-        if (tx.isCoinbase())
-        {
-            res["inputs"] = json::array();
-        }
-        else
+        json::array_t inputData, outputData;
+        if (!tx.isCoinbase())
         {
+            inputData.reserve(tx.inputCount());
             for (const auto &input : inputs)
             {
-                res["inputs"].push_back(MakeInputData(input));
+                inputData.push_back(MakeInputData(input));
                 inputValue += input.getValue();
             }
         }
-        for (const auto &output : outputs)
+        if (limits.dust <= 0 && (limits.topOutputs == 0 || tx.outputCount() <= limits.topOutputs))
         {
-            res["outputs"].push_back(MakeOutputData(output));
-            outputValue += output.getValue();
+            outputData.reserve(tx.outputCount());
+            for (const auto &output : outputs)
+            {
+                outputData.push_back(MakeOutputData(output));
+                outputValue += output.getValue();
+            }
+        }
+        else
+        {
+            // 먼지 출력은 요약만 하고, 나머지는 값이 큰 topOutputs 개만 소비 정보까지 만든다
+            DustSummary dust;
+            std::vector<blocksci::Output> kept;
+            kept.reserve(tx.outputCount());
+            for (const auto &output : outputs)
+            {
+                outputValue += output.getValue();
+                if (output.getValue() < limits.dust)
+                    dust.add(output);
+                else
+                    kept.push_back(output);
+            }
+            size_t shown = kept.size();
+            if (limits.topOutputs > 0 && kept.size() > limits.topOutputs)
+            {
+                shown = limits.topOutputs;
+                std::partial_sort(kept.begin(), kept.begin() + shown, kept.end(), byValue);
+            }
+            outputData.reserve(shown);
+            for (size_t i = 0; i < shown; ++i)
+                outputData.push_back(MakeOutputData(kept[i]));
+            if (limits.dust > 0)
+                res["dust_outputs"] = dust.toJson(limits.dust);
+            res["n_more_outputs"] = kept.size() - shown;
         }
+        res["inputs"] = std::move(inputData);
+        res["outputs"] = std::move(outputData);
 
         res["input_value"] = std::move(inputValue);
         res["output_value"] = std::move(outputValue);
         res["fee"] = inputValue == 0 ? 0 : inputValue - outputValue;
         res["profile"] = mongo.getProfile(hash);
-        return res.dump();
+        return res;
     }
     catch (const std::exception &e)
     {
@@ -73,15 +147,60 @@ std::string ProcessApi::getTxData(const utility::string_t &req)
     }
 }
 
-std::string ProcessApi::getWalletData(const utility::string_t &req)
+json ProcessApi::getTxOutputs(const utility::string_t &req, int64_t dust, size_t offset, size_t limit)
 {
+    if (limit == 0 || limit > MAX_OUTPUT_PAGE_SIZE)
+        throw std::invalid_argument("Invalid limit, at most " + std::to_string(MAX_OUTPUT_PAGE_SIZE));
     std::string hash = utility::conversions::to_utf8string(req);
+    blocksci::Transaction tx;
+    try
+    {
+        tx = blocksci::Transaction(hash, chain.getAccess());
+    }
+    catch(const std::exception &e)
+    {
+        throw InvalidHash("Invalid Transaction hash");
+    }
+
+    // getTxData 의 top 출력과 같은 순서라 offset=top 부터 이어서 받을 수 있다
+    std::vector<blocksci::Output> ranked;
+    ranked.reserve(tx.outputCount());
+    for (const auto &output : tx.outputs())
+    {
+        if (output.getValue() >= dust)
+            ranked.push_back(output);
+    }
+    offset = std::min(offset, ranked.size());
+    size_t end = offset + std::min(limit, ranked.size() - offset);
+    std::partial_sort(ranked.begin(), ranked.begin() + end, ranked.end(), byValue);
+
+    json res;
+    res["txid"] = tx.getHash().GetHex();
+    res["n_output"] = tx.outputCount();
+    res["n_total"] = ranked.size();
+    res["offset"] = offset;
+    res["limit"] = limit;
+    json::array_t outputData;
+    outputData.reserve(end - offset);
+    for (size_t i = offset; i < end; ++i)
+        outputData.push_back(MakeOutputData(ranked[i]));
+    res["outputs"] = std::move(outputData);
+    return res;
+}
+
+json ProcessApi::getWalletData(const utility::string_t &req)
+{
+    std::string hash = utility::conversions::to_utf8string(req);
+    // 체인에 없는 주소가 확실하면 BlockSci 색인과 Mongo 를 거치지 않는다
+    if (addressFilter && addressFilter->absent(hash))
+    {
+        throw InvalidHash("Invalid address");
+    }
     auto address = blocksci::getAddressFromString(hash, chain.getAccess());
     if (!address)
     {
         throw InvalidHash("Invalid address");
     }
-    MongoDB mongo(mongoUri);
     json res;
     auto viewTxs = address->getTransactions();
     auto viewInputTxs = address->getInputTransactions();
@@ -152,13 +271,27 @@ std::string ProcessApi::getWalletData(const utility::string_t &req)
     res["total_received"] = total_received;
     res["total_sent"] = total_sent;
     res["final_balance"] = total_received - total_sent;
-    res["cluster"] = mongo.clusterFindByAddr(hash);
-    res["profile"] = mongo.getProfile(hash);
-    return res.dump();
+    if (addressFilter && !addressFilter->mayBeLabelled(hash))
+    {
+        res["cluster"] = json::object();
+        res["profile"] = json::object();
+    }
+    else
+    {
+        MongoDB mongo(mongoUri);
+        res["cluster"] = mongo.clusterFindByAddr(hash);
+        res["profile"] = mongo.getProfile(hash);
+    }
+    return res;
 }
 
-std::string ProcessApi::getTxInWallet(const std::string &hash, const time_t &startDate, const time_t &endDate)
+json ProcessApi::getTxInWallet(const std::string &hash, const time_t &startDate, const time_t &endDate,
+                                int64_t dust)
 {
+    if (addressFilter && addressFilter->absent(hash))
+    {
+        throw InvalidHash("Invalid address");
+    }
     auto address = blocksci::getAddressFromString(hash, chain.getAccess());
     if (!address)
     {
@@ -169,6 +302,8 @@ std::string ProcessApi::getTxInWallet(const std::string &hash, const time_t &sta
 
     std::vector<json> txVector;
     int64_t localSentValue, localReceivedValue;
+    DustSummary dustOutputs;
+    uint64_t dustTxs = 0;
 
     for (const auto &tx : viewTxs)
     {
@@ -176,11 +311,7 @@ std::string ProcessApi::getTxInWallet(const std::string &hash, const time_t &sta
             continue;
         if (tx.block().timestamp() > endDate)
             break;
-        json txDoc;
         localSentValue = localReceivedValue = 0;
-        txDoc["txid"] = tx.getHash().GetHex();
-        txDoc["timestamp"] = tx.block().timestamp();
-        txDoc["spending_outpoints"] = json::array();
         for (const auto &input : tx.inputs())
         {
             if (input.getAddress() == *address)
@@ -188,15 +319,35 @@ std::string ProcessApi::getTxInWallet(const std::string &hash, const time_t &sta
         };
         for (const auto &output : tx.outputs())
         {
-            if (output.getAddress() == *address) {
+            if (output.getAddress() == *address)
                 localReceivedValue += output.getValue();
+        }
+        // 보내지 않고 먼지만 받은 거래는 요약에만 더한다
+        if (localSentValue == 0 && localReceivedValue < dust)
+        {
+            ++dustTxs;
+            for (const auto &output : tx.outputs())
+            {
+                if (output.getAddress() == *address)
+                    dustOutputs.add(output);
+            }
+            continue;
+        }
+
+        json txDoc;
+        txDoc["txid"] = tx.getHash().GetHex();
+        txDoc["timestamp"] = tx.block().timestamp();
+        txDoc["spending_outpoints"] = json::array();
+        for (const auto &output : tx.outputs())
+        {
+            if (output.getAddress() == *address) {
                 if(output.isSpent()) {
                     auto spendingInput = output.getSpendingInput();
                     json spending_outpoints;
                     spending_outpoints["txid"] = spendingInput->transaction().getHash().GetHex();
                     spending_outpoints["n"] = spendingInput->inputIndex();
                     spending_outpoints["value"] = output.getValue();
-                    txDoc["spending_outpoints"] = spending_outpoints;
+                    txDoc["spending_outpoints"] = std::move(spending_outpoints);
                 }
             }
         };
@@ -209,25 +360,21 @@ std::string ProcessApi::getTxInWallet(const std::string &hash, const time_t &sta
         return a["index"] > b["index"];
     });
     res["n_tx"] = txVector.size();
-    res["txs"] = txVector;
+    res["txs"] = std::move(txVector);
+    if (dust > 0)
+    {
+        res["dust_txs"] = dustOutputs.toJson(dust);
+        res["dust_txs"]["n_tx"] = dustTxs;
+    }
 
-    return res.dump();
+    return res;
 }
 
-std::string ProcessApi::getClusterData(const utility::string_t &req)
+json ProcessApi::getClusterData(const utility::string_t &req)
 {
     MongoDB mongo(mongoUri);
     std::string target = utility::conversions::to_utf8string(req);
-    std::optional<json> maybeResult;
-    std::regex hexPattern("^[0-9a-fA-F]{24}$");
-    if (std::regex_match(target, hexPattern))
-        maybeResult = mongo.clusterFindById(target);
-    else
-        maybeResult = mongo.clusterFindByName(target);
-
-    if (!maybeResult)
-        throw std::runtime_error("Invalid Cluster");
-    json rawData = *maybeResult;
+    json rawData = findCluster(mongo, target);
     json res;
     res["_id"] = rawData["_id"]["$oid"];
     res["name"] = rawData["name"];
@@ -246,7 +393,241 @@ std::string ProcessApi::getClusterData(const utility::string_t &req)
         res["wallet"].push_back(std::move(doc));
     }
 
-    return res.dump();
+    return res;
+}
+
+json ProcessApi::findCluster(MongoDB &mongo, const std::string &target)
+{
+    std::optional<json> maybeResult;
+    std::regex hexPattern("^[0-9a-fA-F]{24}$");
+    if (std::regex_match(target, hexPattern))
+        maybeResult = mongo.clusterFindById(target);
+    else
+        maybeResult = mongo.clusterFindByName(target);
+
+    if (!maybeResult)
+        throw std::runtime_error("Invalid Cluster");
+    return *maybeResult;
+}
+
+json ProcessApi::getBalanceHistory(const utility::string_t &req, bool isCluster, const std::string &bucketName,
+                                   time_t startDate, time_t endDate)
+{
+    HistoryBucket bucket = BalanceHistory::parseBucket(bucketName);
+    std::string target = utility::conversions::to_utf8string(req);
+    std::shared_ptr<const BalanceSeries> series;
+    json res;
+
+    if (isCluster)
+    {
+        MongoDB mongo(mongoUri);
+        json rawData = findCluster(mongo, target);
+        const json &addresses = rawData["address"];
+        auto &pool = ThreadPool::Instance();
+        size_t chunkSize = addresses.size() / pool.size() + 1;
+        std::vector<std::future<std::vector<std::shared_ptr<const BalanceSeries>>>> futures;
+
+        // 주소별 누적 배열을 병렬로 계산한 뒤 하나로 병합
+        for (size_t begin = 0; begin < addresses.size(); begin += chunkSize)
+        {
+            size_t end = std::min(begin + chunkSize, addresses.size());
+            futures.push_back(pool.submit([this, &addresses, begin, end]
+            {
+                std::vector<std::shared_ptr<const BalanceSeries>> chunk;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    auto address = blocksci::getAddressFromString(addresses[i].get<std::string>(), chain.getAccess());
+                    if (address)
+                        chunk.push_back(balanceHistory.series(*address));
+                }
+                return chunk;
+            }));
+        }
+        for (auto &future : futures)
+            future.wait();
+
+        std::vector<std::shared_ptr<const BalanceSeries>> seriesList;
+        for (auto &future : futures)
+        {
+            auto chunk = future.get();
+            seriesList.insert(seriesList.end(), chunk.begin(), chunk.end());
+        }
+        series = std::make_shared<const BalanceSeries>(BalanceHistory::merge(seriesList));
+        res["cluster"] = rawData["name"];
+        res["n_wallet"] = addresses.size();
+    }
+    else
+    {
+        auto address = blocksci::getAddressFromString(target, chain.getAccess());
+        if (!address)
+        {
+            throw InvalidHash("Invalid address");
+        }
+        series = balanceHistory.series(*address);
+        res["addr"] = target;
+    }
+
+    res["bucket"] = bucketName;
+    res["history"] = BalanceHistory::bucketize(*series, bucket, startDate, endDate);
+    res["final_balance"] = series->empty() ? 0 : series->back().balance;
+    return res;
+}
+
+json ProcessApi::getCounterparties(const utility::string_t &req, bool isCluster, size_t k, const std::string &direction,
+                                   bool rollup)
+{
+    if (direction != "both" && direction != "sent" && direction != "received")
+        throw std::invalid_argument("Invalid direction, expected sent, received or both");
+    if (k == 0 || k > MAX_COUNTERPARTIES)
+        throw std::invalid_argument("Invalid k");
+
+    std::string target = utility::conversions::to_utf8string(req);
+    json res;
+    std::vector<blocksci::Address> addresses;
+    if (isCluster)
+    {
+        MongoDB mongo(mongoUri);
+        json rawData = findCluster(mongo, target);
+        for (const auto &member : rawData["address"])
+        {
+            auto address = blocksci::getAddressFromString(member.get<std::string>(), chain.getAccess());
+            if (address)
+                addresses.push_back(*address);
+        }
+        res["cluster"] = rawData["name"];
+        res["n_wallet"] = rawData["address"].size();
+    }
+    else
+    {
+        auto address = blocksci::getAddressFromString(target, chain.getAccess());
+        if (!address)
+        {
+            throw InvalidHash("Invalid address");
+        }
+        addresses.push_back(*address);
+        res["addr"] = target;
+    }
+
+    // 클러스터 주소끼리 겹치는 거래는 한 번만 집계
+    std::unordered_set<uint64_t> members;
+    std::unordered_set<uint32_t> seen;
+    std::vector<blocksci::Transaction> txs;
+    for (const auto &address : addresses)
+    {
+        members.insert(addressKey(address));
+        for (const auto &tx : address.getTransactions())
+        {
+            if (seen.insert(tx.txNum).second)
+                txs.push_back(tx);
+        }
+    }
+
+    CounterpartyAggregator total(members);
+    if (txs.size() < COUNTERPARTY_PARALLEL_TXS)
+    {
+        for (const auto &tx : txs)
+            total.add(tx);
+    }
+    else
+    {
+        // 거래가 많은 주소는 구간별로 나눠 각자 테이블에 집계한 뒤 병합
+        auto &pool = ThreadPool::Instance();
+        size_t chunkSize = txs.size() / pool.size() + 1;
+        std::vector<std::future<std::unique_ptr<CounterpartyAggregator>>> futures;
+        for (size_t begin = 0; begin < txs.size(); begin += chunkSize)
+        {
+            size_t end = std::min(begin + chunkSize, txs.size());
+            futures.push_back(pool.submit([&txs, &members, begin, end]
+            {
+                auto partial = std::make_unique<CounterpartyAggregator>(members);
+                for (size_t i = begin; i < end; ++i)
+                    partial->add(txs[i]);
+                return partial;
+            }));
+        }
+        for (auto &future : futures)
+            future.wait();
+        for (auto &future : futures)
+            total.merge(*future.get());
+    }
+
+    std::unique_ptr<MongoDB> mongo;
+    if (rollup)
+        mongo = std::make_unique<MongoDB>(mongoUri);
+
+    res["n_tx"] = total.n_tx;
+    if (direction != "received")
+        res["sent"] = MakeCounterpartyData(total.sent, k, mongo.get());
+    if (direction != "sent")
+        res["received"] = MakeCounterpartyData(total.received, k, mongo.get());
+    // 클러스터 묶음은 주소 상위 후보만 보므로, 후보 밖의 작은 주소들로 나뉜 클러스터는 빠질 수 있다
+    if (rollup)
+    {
+        size_t candidates = k * ROLLUP_CANDIDATE_FACTOR;
+        res["approximate"] = (direction != "received" && total.sent.size() > candidates) ||
+                             (direction != "sent" && total.received.size() > candidates);
+    }
+    return res;
+}
+
+json ProcessApi::MakeCounterpartyData(const CounterpartyTable &table, size_t k, MongoDB *mongo)
+{
+    json res = json::array();
+    if (!mongo)
+    {
+        for (const auto &stat : table.top(k))
+        {
+            json doc;
+            doc["addr"] = onlyAddress(addressFromKey(stat.key, chain.getAccess()));
+            doc["value"] = stat.value;
+            doc["count"] = stat.count;
+            res.push_back(std::move(doc));
+        }
+        return res;
+    }
+
+    // Mongo 클러스터 라벨 단위로 묶는다. 조회는 상위 후보로 제한
+    std::vector<json> groups;
+    std::unordered_map<std::string, size_t> groupIndex;
+    for (const auto &stat : table.top(k * ROLLUP_CANDIDATE_FACTOR))
+    {
+        std::string addr = onlyAddress(addressFromKey(stat.key, chain.getAccess()));
+        json cluster = mongo->clusterFindByAddr(addr);
+        bool labelled = cluster.contains("_id");
+        std::string groupKey = labelled ? cluster["_id"]["$oid"].get<std::string>() : addr;
+
+        auto find = groupIndex.find(groupKey);
+        if (find == groupIndex.end())
+        {
+            json doc;
+            if (labelled)
+            {
+                doc["cluster"] = cluster["name"];
+                doc["_id"] = groupKey;
+            }
+            else
+            {
+                doc["addr"] = addr;
+            }
+            doc["value"] = 0;
+            doc["count"] = 0;
+            doc["n_wallet"] = 0;
+            find = groupIndex.emplace(groupKey, groups.size()).first;
+            groups.push_back(std::move(doc));
+        }
+        auto &doc = groups[find->second];
+        doc["value"] = doc["value"].get<int64_t>() + stat.value;
+        doc["count"] = doc["count"].get<uint64_t>() + stat.count;
+        doc["n_wallet"] = doc["n_wallet"].get<uint64_t>() + 1;
+    }
+
+    std::stable_sort(groups.begin(), groups.end(), [](const json &a, const json &b) {
+        return a["value"].get<int64_t>() > b["value"].get<int64_t>();
+    });
+    if (groups.size() > k)
+        groups.resize(k);
+    res = groups;
+    return res;
 }
 
 json ProcessApi::MakeInputData(blocksci::Input input)
@@ -257,11 +638,10 @@ json ProcessApi::MakeInputData(blocksci::Input input)
     res["txid"] = input.getSpentTx().getHash().GetHex();
     res["n"] = input.inputIndex();
 
-    auto address = onlyAddress(input.getAddress().toString());
-    prevData["addr"] = address.empty() ? "Unknown" : address;
+    prevData["addr"] = onlyAddress(input.getAddress());
     prevData["value"] = input.getValue();
 
-    res["prev_out"] = prevData;
+    res["prev_out"] = std::move(prevData);
 
     return res;
 }
@@ -269,8 +649,7 @@ json ProcessApi::MakeInputData(blocksci::Input input)
 json ProcessApi::MakeOutputData(blocksci::Output output)
 {
     json res;
-    auto address = onlyAddress(output.getAddress().toString());
-    res["addr"] = address.empty() ? "Unknown" : address;
+    res["addr"] = onlyAddress(output.getAddress());
     res["value"] = output.getValue();
     res["n"] = output.outputIndex();
     res["spent"] = output.isSpent();
@@ -282,7 +661,7 @@ json ProcessApi::MakeOutputData(blocksci::Output output)
         spending_outpoints["txid"] = spendingInput->transaction().getHash().GetHex();
         spending_outpoints["n"] = spendingInput->inputIndex();
         spending_outpoints["value"] = output.getValue();
-        res["spending_outpoints"] = spending_outpoints;
+        res["spending_outpoints"] = std::move(spending_outpoints);
     }
     else
     {
@@ -292,13 +671,12 @@ json ProcessApi::MakeOutputData(blocksci::Output output)
     return res;
 }
 
-std::string ProcessApi::onlyAddress(const std::string &fullString)
+std::string ProcessApi::onlyAddress(const blocksci::Address &address)
 {
-    std::string delimiter = "(";
-    return fullString.substr(fullString.find(delimiter) + 1, fullString.size() - fullString.find(delimiter) - 2);
+    return addressEncoder.encode(address);
 }
 
-std::string ProcessApi::getClusterResult(const utility::string_t &req)
+json ProcessApi::getClusterResult(const utility::string_t &req)
 {
     std::string hash = utility::conversions::to_utf8string(req);
     auto address = blocksci::getAddressFromString(hash, chain.getAccess());
@@ -307,18 +685,144 @@ std::string ProcessApi::getClusterResult(const utility::string_t &req)
         throw InvalidHash("Invalid address");
     }
 
+    json res;
+    // 증분 클러스터 인덱스가 체인 끝까지 따라잡았으면 오프라인 클러스터 디렉터리 대신 사용
+    if (clusterIndex && clusterIndex->caughtUp())
+    {
+        auto members = clusterIndex->members(*address, CLUSTER_MEMBER_LIMIT + 1);
+        res["truncated"] = members.size() > CLUSTER_MEMBER_LIMIT;
+        if (members.size() > CLUSTER_MEMBER_LIMIT)
+            members.resize(CLUSTER_MEMBER_LIMIT);
+        // P2PK 와 P2PKH 는 같은 문자열이므로 한 번만
+        std::unordered_set<std::string> listed;
+        for (const auto &member : members)
+        {
+            std::string text = onlyAddress(member);
+            if (listed.insert(text).second)
+                res["addresses"].push_back(std::move(text));
+        }
+        res["processed_height"] = clusterIndex->processedHeight();
+        return res;
+    }
+
     blocksci::ClusterManager cm("/home/bitcoin-core/.blocksci/cluster", chain.getAccess());
     auto cluster = cm.getCluster(*address);
     auto addresses = cluster.getAddresses();     
-    json res;
     for (const auto &address : addresses)
     {
-        res["addresses"].push_back(onlyAddress(address.toString()));
+        res["addresses"].push_back(onlyAddress(address));
     }
-    return res.dump();
+    return res;
+}
+
+/* 주소를 주면 BlockSci 클러스터, 아니면 Mongo 클러스터(id / 이름)의 height 시점 UTXO */
+json ProcessApi::getClusterUtxos(const utility::string_t &req, blocksci::BlockHeight height, size_t offset, size_t limit)
+{
+    if (height < 0)
+        height = chain.size() - 1;
+    if (height >= chain.size())
+        throw std::invalid_argument("Invalid height");
+    if (limit == 0 || limit > MAX_UTXO_PAGE_SIZE)
+        throw std::invalid_argument("Invalid limit, at most " + std::to_string(MAX_UTXO_PAGE_SIZE));
+
+    std::string target = utility::conversions::to_utf8string(req);
+    std::vector<blocksci::Address> addresses;
+    json res;
+    auto address = blocksci::getAddressFromString(target, chain.getAccess());
+    if (address)
+    {
+        addresses = clusterAddresses(*address);
+        res["addr"] = target;
+    }
+    else
+    {
+        MongoDB mongo(mongoUri);
+        json rawData = findCluster(mongo, target);
+        for (const auto &addr : rawData["address"])
+        {
+            auto member = blocksci::getAddressFromString(addr.get<std::string>(), chain.getAccess());
+            if (member)
+                addresses.push_back(*member);
+        }
+        res["cluster"] = rawData["name"];
+    }
+
+    auto utxos = utxoIndex.clusterUtxos(target, addresses, height);
+    int64_t total = 0;
+    for (const auto &utxo : *utxos)
+        total += utxo.value;
+
+    res["height"] = height;
+    res["n_wallet"] = addresses.size();
+    res["n_utxo"] = utxos->size();
+    res["total_value"] = total;
+    res["offset"] = offset;
+    res["limit"] = limit;
+    res["utxos"] = json::array();
+    for (size_t i = offset; i < utxos->size() && i < offset + limit; ++i)
+    {
+        const auto &utxo = (*utxos)[i];
+        json doc;
+        doc["txid"] = blocksci::Transaction(utxo.txNum, utxo.height, chain.getAccess()).getHash().GetHex();
+        doc["n"] = utxo.index;
+        doc["value"] = utxo.value;
+        doc["addr"] = onlyAddress(addressFromKey(utxo.address, chain.getAccess()));
+        doc["block_height"] = utxo.height;
+        res["utxos"].push_back(std::move(doc));
+    }
+    return res;
+}
+
+std::vector<blocksci::Address> ProcessApi::clusterAddresses(const blocksci::Address &address)
+{
+    std::vector<blocksci::Address> res;
+    // 인덱스가 체인 끝까지 따라잡기 전에는 BlockSci 클러스터를 쓴다
+    if (clusterIndex && clusterIndex->caughtUp())
+    {
+        return clusterIndex->members(address, CLUSTER_MEMBER_LIMIT);
+    }
+
+    blocksci::ClusterManager cm("/home/bitcoin-core/.blocksci/cluster", chain.getAccess());
+    for (const auto &member : cm.getCluster(address).getAddresses())
+        res.push_back(member);
+    return res;
+}
+
+json ProcessApi::getClusterSizes()
+{
+    if (!clusterIndex)
+        throw std::runtime_error("Cluster index is not enabled");
+    return clusterIndex->sizeSnapshot();
+}
+
+json ProcessApi::getRangeAnalytics(time_t startDate, time_t endDate)
+{
+    return rangeAnalytics.query(startDate, endDate);
+}
+
+void ProcessApi::setClusterIndex(ClusterIndex *index)
+{
+    clusterIndex = index;
+}
+
+json ProcessApi::search(const utility::string_t &prefix, size_t limit)
+{
+    if (!searchIndex)
+        throw std::runtime_error("Search index is not enabled");
+    return searchIndex->search(utility::conversions::to_utf8string(prefix), limit);
 }
 
-std::string ProcessApi::getHeuristicResult(const utility::string_t &req)
+void ProcessApi::setSearchIndex(SearchIndex *index)
+{
+    searchIndex = index;
+}
+
+void ProcessApi::setAddressFilter(const AddressFilter *filter)
+{
+    addressFilter = filter;
+}
+
+json ProcessApi::getHeuristicResult(const utility::string_t &req)
 {
     json res;
     std::string hash = utility::conversions::to_utf8string(req);
@@ -327,7 +831,7 @@ std::string ProcessApi::getHeuristicResult(const utility::string_t &req)
     {
         blocksci::Transaction tx(hash, chain.getAccess());
         res["addresses"] = determineChangeAddresses(tx);
-        return res.dump();
+        return res;
     }
     catch(const std::exception &e)
     {
@@ -335,59 +839,95 @@ std::string ProcessApi::getHeuristicResult(const utility::string_t &req)
     }
 }
 
-std::vector<std::string> ProcessApi::determineChangeAddresses(const blocksci::Transaction &tx) {
+void ProcessApi::checkScanRange(blocksci::BlockHeight start, blocksci::BlockHeight end)
+{
+    if (start < 0 || end < start || end >= chain.size())
+        throw std::invalid_argument("Invalid block height range");
+    if (end - start + 1 > MAX_SCAN_BLOCKS)
+        throw std::invalid_argument("Too many blocks, at most " + std::to_string(MAX_SCAN_BLOCKS));
+}
 
-    std::unordered_map<blocksci::Output, int> outputScores;
-    std::vector<std::string> noChnageAddress;
-    blocksci::heuristics::PeelingChainChange peelingChainChange;
-    blocksci::heuristics::PowerOfTenChange powerOfTenChange(6); // `6`은 10의 거듭제곱의 자릿수를 나타냅니다.
-    blocksci::heuristics::OptimalChangeChange optimalChangeChange;
-    blocksci::heuristics::AddressTypeChange addressTypeChange;
-    blocksci::heuristics::LocktimeChange locktimeChange;
-    blocksci::heuristics::AddressReuseChange addressReuseChange;
-    blocksci::heuristics::ClientChangeAddressBehaviorChange clientChangeBehaviorChange;
-    blocksci::heuristics::LegacyChange legacyChange;
-    blocksci::heuristics::FixedFee fixedFeeChange;
-    blocksci::heuristics::Spent spentChange;
+/* 블록 구간의 모든 거래에 잔돈/CoinJoin 휴리스틱을 병렬 적용. 결과는 완료되는 대로 emit 으로 전달 */
+json ProcessApi::scanHeuristics(blocksci::BlockHeight start, blocksci::BlockHeight end,
+                                const std::function<void(const json &)> &emit)
+{
+    checkScanRange(start, end);
+    auto begin = std::chrono::steady_clock::now();
+    auto &pool = ThreadPool::Instance();
+    std::deque<std::future<uint64_t>> futures; // 진행 중인 청크, 최대 SCAN_INFLIGHT_CHUNKS 개
+    uint64_t scanned = 0;
 
-    for(const auto &output: tx.outputs()){
-        outputScores[output] = 0;
-    }
-    for (const auto &item : addressReuseChange(tx)) {
-        outputScores[item] += ADDRESS_REUSE_SCORE;
-    }
-    for (const auto &item : peelingChainChange(tx)) {
-        outputScores[item] += PEELING_CHAIN_SCORE;
-    }
-    for (const auto &item : powerOfTenChange(tx)) {
-        outputScores[item] += POWER_OF_TEN_SCORE;
-    }
-    for (const auto &item : optimalChangeChange(tx)) {
-        outputScores[item] += OPTIMAL_CHANGE_SCORE;
-    }
-    for (const auto &item : addressTypeChange(tx)) {
-        outputScores[item] += ADDRESS_TYPE_SCORE;
-    }
-    for (const auto &item : locktimeChange(tx)) {
-        outputScores[item] += LOCKTIME_SCORE;
-    }
-    for (const auto &item : clientChangeBehaviorChange(tx)) {
-        outputScores[item] += CLIENT_BEHAVIOR_SCORE;
-    }
-    for (const auto &item : legacyChange(tx)) {
-        outputScores[item] += LEGACY_SCORE;
-    }
-    for (const auto &item : fixedFeeChange(tx)) {
-        outputScores[item] += FIXED_FEE_SCORE;
+    try
+    {
+        for (auto height = start; height <= end; ++height)
+        {
+            uint32_t n_tx = chain[height].size();
+            for (uint32_t first = 0; first < n_tx; first += SCAN_CHUNK_TXS)
+            {
+                uint32_t last = std::min(n_tx, first + SCAN_CHUNK_TXS);
+                if (futures.size() >= SCAN_INFLIGHT_CHUNKS)
+                {
+                    scanned += futures.front().get();
+                    futures.pop_front();
+                }
+                futures.push_back(pool.submit([this, height, first, last, &emit]
+                {
+                    auto block = chain[height];
+                    for (uint32_t i = first; i < last; ++i)
+                    {
+                        auto tx = block[i];
+                        json res;
+                        res["txid"] = tx.getHash().GetHex();
+                        res["block_height"] = height;
+                        res["index"] = tx.txNum;
+                        res["true_recipient"] = determineChangeAddresses(tx);
+                        res["is_CoinJoin"] = blocksci::heuristics::isCoinjoin(tx);
+                        emit(res);
+                    }
+                    return static_cast<uint64_t>(last - first);
+                }));
+            }
+        }
+        while (!futures.empty())
+        {
+            scanned += futures.front().get();
+            futures.pop_front();
+        }
     }
-    for (const auto &item : spentChange(tx)) {
-        outputScores[item] += SPENT_SCORE;
+    catch (...)
+    {
+        // 남은 청크가 emit 을 참조하므로 모두 끝난 뒤에 예외를 넘긴다
+        for (auto &future : futures)
+            if (future.valid())
+                future.wait();
+        throw;
     }
 
-    for (const auto &pair : outputScores) {
-        if (pair.second < THRESHOLD_SCORE) {
-            noChnageAddress.push_back(onlyAddress(pair.first.getAddress().toString()));
-        }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    auto &metrics = Metrics::Instance();
+    metrics.heuristicTxs += scanned;
+    metrics.heuristicMicros += elapsed.count();
+
+    double seconds = elapsed.count() / 1e6;
+    json res;
+    res["summary"]["start_height"] = start;
+    res["summary"]["end_height"] = end;
+    res["summary"]["n_tx"] = scanned;
+    res["summary"]["seconds"] = seconds;
+    res["summary"]["tx_per_second"] = seconds > 0 ? scanned / seconds : 0.0;
+    res["summary"]["threads"] = pool.size();
+    return res;
+}
+
+json ProcessApi::determineChangeAddresses(const blocksci::Transaction &tx) {
+
+    thread_local ChangeHeuristic heuristic;
+    auto outputs = heuristic.nonChangeOutputs(tx);
+    json::array_t noChnageAddress;
+    noChnageAddress.reserve(outputs.size());
+
+    for (const auto &output : outputs) {
+        noChnageAddress.push_back(onlyAddress(output.getAddress()));
     }
     
     return noChnageAddress;
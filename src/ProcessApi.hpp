@@ -5,44 +5,81 @@
 #include <cpprest/http_listener.h>
 #include <cpprest/json.h>
 #include <regex>
+#include <functional>
 #include <deque>
 #include <unordered_map>
 #include <vector>
 #include "MongoDB.hpp"
+#include "AddressEncoder.hpp"
+#include "BalanceHistory.hpp"
+#include "ThreadPool.hpp"
+#include "ChangeHeuristic.hpp"
+#include "Counterparties.hpp"
+#include "ClusterIndex.hpp"
+#include "SearchIndex.hpp"
+#include "RangeAnalytics.hpp"
+#include "UtxoIndex.hpp"
+#include "AddressFilter.hpp"
+#include "Metrics.hpp"
 using json = nlohmann::json;
 
-const int THRESHOLD_SCORE = 8;
+const int MAX_SCAN_BLOCKS = 1000;
+const uint32_t SCAN_CHUNK_TXS = 256;
+const size_t SCAN_INFLIGHT_CHUNKS = 32; // 스캔 하나가 풀 큐에 한 번에 올리는 청크 수
+const size_t MAX_OUTPUT_PAGE_SIZE = 1000;
 
-const int PEELING_CHAIN_SCORE = 3;
-const int POWER_OF_TEN_SCORE = 2;
-const int OPTIMAL_CHANGE_SCORE = 2;
-const int ADDRESS_TYPE_SCORE = 1;
-const int LOCKTIME_SCORE = 1;
-const int ADDRESS_REUSE_SCORE = 3;
-const int CLIENT_BEHAVIOR_SCORE = 2;
-const int LEGACY_SCORE = 1;
-const int FIXED_FEE_SCORE = 1;
-const int SPENT_SCORE = 1;
+/* 먼지/대량 출력 요약 옵션. 0 이면 해당 기능을 쓰지 않는다 */
+struct OutputLimits
+{
+  int64_t dust = 0;      // 이 값(satoshi) 미만의 출력, 입금 거래는 개수와 합계로만
+  size_t topOutputs = 0; // 거래 출력은 값이 큰 순서로 이만큼만, 나머지는 /info/txid/outputs 로
+};
 
 class ProcessApi
 {
 public:
   ProcessApi() = default;
   ProcessApi(blocksci::Blockchain &chain, const std::string &mongoUri);
-  std::string getTxData(const utility::string_t &input);
-  std::string getWalletData(const utility::string_t &req);
-  std::string getTxInWallet(const std::string &hash, const time_t &startDate, const time_t &endDate);
-  std::string getClusterData(const utility::string_t &req);
-  std::string getClusterResult(const utility::string_t &req);
-  std::string getHeuristicResult(const utility::string_t &req);
+  json getTxData(const utility::string_t &input, const OutputLimits &limits = OutputLimits());
+  json getTxOutputs(const utility::string_t &input, int64_t dust, size_t offset, size_t limit);
+  json getWalletData(const utility::string_t &req);
+  json getTxInWallet(const std::string &hash, const time_t &startDate, const time_t &endDate,
+                     int64_t dust = 0);
+  json getClusterData(const utility::string_t &req);
+  json getClusterResult(const utility::string_t &req);
+  json getHeuristicResult(const utility::string_t &req);
+  json getBalanceHistory(const utility::string_t &req, bool isCluster, const std::string &bucketName,
+                         time_t startDate, time_t endDate);
+  json getCounterparties(const utility::string_t &req, bool isCluster, size_t k, const std::string &direction,
+                         bool rollup);
+  json getClusterSizes();
+  json getClusterUtxos(const utility::string_t &req, blocksci::BlockHeight height, size_t offset, size_t limit);
+  json getRangeAnalytics(time_t startDate, time_t endDate);
+  void checkScanRange(blocksci::BlockHeight start, blocksci::BlockHeight end);
+  json scanHeuristics(blocksci::BlockHeight start, blocksci::BlockHeight end,
+                      const std::function<void(const json &)> &emit);
+  void setClusterIndex(ClusterIndex *index);
+  json search(const utility::string_t &prefix, size_t limit);
+  void setSearchIndex(SearchIndex *index);
+  void setAddressFilter(const AddressFilter *filter);
 
 private:
   blocksci::Blockchain &chain;
   const std::string &mongoUri;
+  AddressEncoder addressEncoder;
+  BalanceHistory balanceHistory;
+  ClusterIndex *clusterIndex = nullptr;
+  SearchIndex *searchIndex = nullptr;
+  const AddressFilter *addressFilter = nullptr;
+  RangeAnalytics rangeAnalytics;
+  UtxoIndex utxoIndex;
+  json findCluster(MongoDB &mongo, const std::string &target);
+  std::vector<blocksci::Address> clusterAddresses(const blocksci::Address &address);
+  json MakeCounterpartyData(const CounterpartyTable &table, size_t k, MongoDB *mongo);
   json MakeInputData(blocksci::Input input);
   json MakeOutputData(blocksci::Output output);
-  std::string onlyAddress(const std::string &fullString);
-  std::vector<std::string> determineChangeAddresses(const blocksci::Transaction &tx);
+  std::string onlyAddress(const blocksci::Address &address);
+  json determineChangeAddresses(const blocksci::Transaction &tx);
 };
 
 class InvalidHash : public std::runtime_error {
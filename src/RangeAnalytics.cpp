@@ -0,0 +1,260 @@
+#include "RangeAnalytics.hpp"
+#include "AddressEncoder.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+
+namespace
+{
+  const time_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+  bool byValue(const Transfer &a, const Transfer &b)
+  {
+    return a.value > b.value;
+  }
+}
+
+void RangeStats::addBlock(const blocksci::Block &block)
+{
+  ++n_block;
+  for (const auto &tx : block)
+  {
+    int64_t outputTotal = 0;
+    uint32_t touched = 0; // 입출력에 나타난 주소 타입 비트
+    ++n_tx;
+    for (const auto &output : tx.outputs())
+    {
+      size_t slot = static_cast<size_t>(output.getAddress().type) % ANALYTICS_TYPE_SLOTS;
+      ++outputCount[slot];
+      outputValue[slot] += output.getValue();
+      outputTotal += output.getValue();
+      touched |= 1u << slot;
+    }
+    for (const auto &input : tx.inputs())
+      touched |= 1u << (static_cast<size_t>(input.getAddress().type) % ANALYTICS_TYPE_SLOTS);
+    for (size_t slot = 0; slot < ANALYTICS_TYPE_SLOTS; ++slot)
+      txCount[slot] += touched >> slot & 1;
+
+    if (tx.isCoinbase())
+    {
+      coinbaseValue += outputTotal;
+      continue;
+    }
+    volume += outputTotal;
+    fees += tx.fee();
+    if (blocksci::heuristics::isCoinjoin(tx))
+      ++n_coinjoin;
+    addTransfer({outputTotal, tx.txNum, block.height()});
+  }
+}
+
+void RangeStats::merge(const RangeStats &other)
+{
+  n_block += other.n_block;
+  n_tx += other.n_tx;
+  n_coinjoin += other.n_coinjoin;
+  volume += other.volume;
+  fees += other.fees;
+  coinbaseValue += other.coinbaseValue;
+  for (size_t i = 0; i < ANALYTICS_TYPE_SLOTS; ++i)
+  {
+    txCount[i] += other.txCount[i];
+    outputCount[i] += other.outputCount[i];
+    outputValue[i] += other.outputValue[i];
+  }
+  for (const auto &transfer : other.largest)
+    addTransfer(transfer);
+}
+
+void RangeStats::addTransfer(const Transfer &transfer)
+{
+  if (largest.size() < LARGEST_TRANSFERS)
+  {
+    largest.push_back(transfer);
+    std::push_heap(largest.begin(), largest.end(), byValue);
+  }
+  else if (transfer.value > largest.front().value)
+  {
+    std::pop_heap(largest.begin(), largest.end(), byValue);
+    largest.back() = transfer;
+    std::push_heap(largest.begin(), largest.end(), byValue);
+  }
+}
+
+RangeAnalytics::RangeAnalytics(blocksci::Blockchain &chain) : chain(chain) {}
+
+json RangeAnalytics::query(time_t start, time_t end)
+{
+  if (start < 0)
+    throw std::invalid_argument("start must not be negative");
+  if (end < start)
+    throw std::invalid_argument("end must not be before start");
+  // 체인 끝 이후는 블록이 없으므로 잘라낸다 (end + 1 의 overflow 방지)
+  end = std::min(end, tipTime());
+
+  struct Job
+  {
+    blocksci::BlockHeight begin;
+    blocksci::BlockHeight end;
+    time_t day; // 캐시할 하루치 작업이면 그 날의 시작 시각, 아니면 -1
+  };
+  std::vector<Job> jobs;
+  std::vector<std::shared_ptr<const RangeStats>> cached;
+
+  // [from, to) 시간 구간을 청크 작업으로 분할
+  auto addLive = [this, &jobs](time_t from, time_t to)
+  {
+    blocksci::BlockHeight begin = heightAt(from), last = heightAt(to);
+    for (blocksci::BlockHeight height = begin; height < last; height += ANALYTICS_CHUNK_BLOCKS)
+      jobs.push_back({height, std::min<blocksci::BlockHeight>(height + ANALYTICS_CHUNK_BLOCKS, last), -1});
+  };
+
+  time_t closedUntil = tipTime() - DAY_CLOSE_MARGIN;
+  time_t firstDay = (start + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY * SECONDS_PER_DAY;
+  time_t endDay = (end + 1) / SECONDS_PER_DAY * SECONDS_PER_DAY;
+  if (firstDay < endDay)
+  {
+    addLive(start, firstDay);
+    for (time_t day = firstDay; day < endDay; day += SECONDS_PER_DAY)
+    {
+      if (day + SECONDS_PER_DAY > closedUntil)
+      {
+        addLive(day, day + SECONDS_PER_DAY);
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      auto find = dayCache.find(day);
+      if (find != dayCache.end())
+        cached.push_back(find->second);
+      else
+        jobs.push_back({heightAt(day), heightAt(day + SECONDS_PER_DAY), day});
+    }
+    addLive(endDay, end + 1);
+  }
+  else
+  {
+    addLive(start, end + 1);
+  }
+
+  // 캐시되지 않은 부분이 크면 공유 ThreadPool 을 오래 차지하므로 거절한다
+  int64_t scanBlocks = 0;
+  for (const auto &job : jobs)
+    scanBlocks += job.end - job.begin;
+  if (scanBlocks > MAX_ANALYTICS_BLOCKS)
+    throw std::invalid_argument("Range too large, at most " + std::to_string(MAX_ANALYTICS_BLOCKS) +
+                                " uncached blocks per request");
+
+  auto &pool = ThreadPool::Instance();
+  std::vector<std::future<RangeStats>> futures;
+  for (const auto &job : jobs)
+  {
+    futures.push_back(pool.submit([this, job]
+                                  { return compute(job.begin, job.end); }));
+  }
+  for (auto &future : futures)
+    future.wait();
+
+  RangeStats total;
+  for (size_t i = 0; i < jobs.size(); ++i)
+  {
+    auto stats = std::make_shared<const RangeStats>(futures[i].get());
+    total.merge(*stats);
+    if (jobs[i].day >= 0)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      dayCache.emplace(jobs[i].day, stats);
+    }
+  }
+  for (const auto &stats : cached)
+    total.merge(*stats);
+
+  json res = toJson(total);
+  res["start"] = start;
+  res["end"] = end;
+  res["start_height"] = heightAt(start);
+  res["end_height"] = heightAt(end + 1) - 1;
+  res["n_cached_day"] = cached.size();
+  return res;
+}
+
+/*
+ * 그 블록까지의 최대 timestamp 가 time 이상인 첫 블록 높이.
+ * 블록 timestamp 는 단조 증가하지 않으므로 누적 최대값으로 찾는다 (BalanceHistory 와 같은 보정)
+ */
+blocksci::BlockHeight RangeAnalytics::heightAt(time_t time)
+{
+  std::lock_guard<std::mutex> lock(timeMutex);
+  extendTimes();
+  return std::lower_bound(maxTimes.begin(), maxTimes.end(), time, [](uint32_t blockTime, time_t t)
+                          { return static_cast<time_t>(blockTime) < t; }) - maxTimes.begin();
+}
+
+time_t RangeAnalytics::tipTime()
+{
+  std::lock_guard<std::mutex> lock(timeMutex);
+  extendTimes();
+  return maxTimes.empty() ? 0 : maxTimes.back();
+}
+
+void RangeAnalytics::extendTimes()
+{
+  blocksci::BlockHeight last = chain.size();
+  uint32_t time = maxTimes.empty() ? 0 : maxTimes.back();
+  for (blocksci::BlockHeight height = maxTimes.size(); height < last; ++height)
+  {
+    time = std::max<uint32_t>(time, chain[height].timestamp());
+    maxTimes.push_back(time);
+  }
+}
+
+RangeStats RangeAnalytics::compute(blocksci::BlockHeight begin, blocksci::BlockHeight end) const
+{
+  RangeStats stats;
+  for (blocksci::BlockHeight height = begin; height < end; ++height)
+    stats.addBlock(chain[height]);
+  return stats;
+}
+
+json RangeAnalytics::toJson(const RangeStats &stats) const
+{
+  json res;
+  uint64_t n_regular_tx = stats.n_tx - stats.n_block;
+  res["n_block"] = stats.n_block;
+  res["n_tx"] = stats.n_tx;
+  res["n_coinjoin"] = stats.n_coinjoin;
+  res["coinjoin_share"] = n_regular_tx == 0 ? 0.0 : static_cast<double>(stats.n_coinjoin) / n_regular_tx;
+  res["volume"] = stats.volume;
+  res["fees"] = stats.fees;
+  res["coinbase_value"] = stats.coinbaseValue;
+
+  // 거래 수는 입출력에 그 타입이 하나라도 있으면 한 번씩 센다
+  res["tx_by_type"] = json::object();
+  res["outputs_by_type"] = json::object();
+  for (size_t i = 0; i < ANALYTICS_TYPE_SLOTS; ++i)
+  {
+    std::string name = addressTypeName(static_cast<blocksci::AddressType::Enum>(i));
+    if (stats.txCount[i] > 0)
+      res["tx_by_type"][name] = stats.txCount[i];
+    if (stats.outputCount[i] == 0)
+      continue;
+    json doc;
+    doc["n_output"] = stats.outputCount[i];
+    doc["value"] = stats.outputValue[i];
+    res["outputs_by_type"][name] = std::move(doc);
+  }
+
+  auto largest = stats.largest;
+  std::sort(largest.begin(), largest.end(), byValue);
+  res["largest_transfers"] = json::array();
+  for (const auto &transfer : largest)
+  {
+    json doc;
+    doc["txid"] = blocksci::Transaction(transfer.txNum, transfer.height, chain.getAccess()).getHash().GetHex();
+    doc["value"] = transfer.value;
+    doc["block_height"] = transfer.height;
+    res["largest_transfers"].push_back(std::move(doc));
+  }
+  return res;
+}
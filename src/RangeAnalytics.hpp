@@ -0,0 +1,73 @@
+#ifndef RANGEANALYTICS_HPP
+#define RANGEANALYTICS_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+const size_t ANALYTICS_TYPE_SLOTS = 16;
+const size_t LARGEST_TRANSFERS = 10;
+const int ANALYTICS_CHUNK_BLOCKS = 200;
+const int MAX_ANALYTICS_BLOCKS = 10000; // 요청 하나가 새로 집계할 수 있는 최대 블록 수 (캐시된 하루치 제외)
+const time_t DAY_CLOSE_MARGIN = 2 * 60 * 60; // 블록 시간 오차를 감안해 마감으로 보는 여유
+
+struct Transfer
+{
+  int64_t value;
+  uint32_t txNum;
+  blocksci::BlockHeight height;
+};
+
+/* 블록 구간 하나의 집계값. 청크별로 따로 모은 뒤 merge 한다. */
+struct RangeStats
+{
+  uint64_t n_block = 0;
+  uint64_t n_tx = 0;
+  uint64_t n_coinjoin = 0;
+  int64_t volume = 0; // coinbase 제외 출력 합계
+  int64_t fees = 0;
+  int64_t coinbaseValue = 0;
+  std::array<uint64_t, ANALYTICS_TYPE_SLOTS> txCount{}; // 그 타입을 입출력에 가진 거래 수
+  std::array<uint64_t, ANALYTICS_TYPE_SLOTS> outputCount{};
+  std::array<int64_t, ANALYTICS_TYPE_SLOTS> outputValue{};
+  std::vector<Transfer> largest; // value 기준 min-heap
+
+  void addBlock(const blocksci::Block &block);
+  void merge(const RangeStats &other);
+
+private:
+  void addTransfer(const Transfer &transfer);
+};
+
+/*
+ * 시간 구간 -> 블록 높이 구간으로 바꾼 뒤 청크 단위로 병렬 집계.
+ * 완전히 지난 UTC 하루치 결과는 캐시해서 재사용한다.
+ */
+class RangeAnalytics
+{
+public:
+  RangeAnalytics(blocksci::Blockchain &chain);
+  json query(time_t start, time_t end);
+
+private:
+  blocksci::Blockchain &chain;
+  std::mutex mutex;
+  std::map<time_t, std::shared_ptr<const RangeStats>> dayCache;
+  std::mutex timeMutex;
+  std::vector<uint32_t> maxTimes; // 높이별 그 블록까지의 최대 timestamp
+
+  blocksci::BlockHeight heightAt(time_t time);
+  time_t tipTime();
+  // timeMutex 를 잡은 채로, 체인에 새로 생긴 블록만큼 maxTimes 를 늘린다
+  void extendTimes();
+  RangeStats compute(blocksci::BlockHeight begin, blocksci::BlockHeight end) const;
+  json toJson(const RangeStats &stats) const;
+};
+
+#endif
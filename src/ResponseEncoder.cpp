@@ -0,0 +1,161 @@
+#include "ResponseEncoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+namespace
+{
+  const char *HASH_KEYS[] = {"txid", "block_hash"};
+  const size_t HASH_HEX_LENGTH = 64;
+
+  int hexValue(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  bool isHashKey(const std::string &key)
+  {
+    return std::any_of(std::begin(HASH_KEYS), std::end(HASH_KEYS),
+                       [&key](const char *name)
+                       { return key == name; });
+  }
+
+  std::string trim(const std::string &value)
+  {
+    auto first = value.find_first_not_of(" \t");
+    if (first == std::string::npos)
+      return "";
+    auto last = value.find_last_not_of(" \t");
+    return value.substr(first, last - first + 1);
+  }
+}
+
+ResponseFormat ResponseEncoder::negotiate(const utility::string_t &accept)
+{
+  std::string header = utility::conversions::to_utf8string(accept);
+  ResponseFormat best = ResponseFormat::Json;
+  double bestQuality = 0.0;
+  size_t start = 0;
+
+  while (start <= header.size())
+  {
+    size_t end = header.find(',', start);
+    if (end == std::string::npos)
+      end = header.size();
+    std::string range = header.substr(start, end - start);
+    start = end + 1;
+
+    double quality = 1.0;
+    size_t params = range.find(';');
+    std::string mediaType = trim(range.substr(0, params));
+    std::transform(mediaType.begin(), mediaType.end(), mediaType.begin(), ::tolower);
+    if (params != std::string::npos)
+    {
+      size_t q = range.find("q=", params);
+      if (q != std::string::npos)
+        quality = std::atof(range.c_str() + q + 2);
+    }
+
+    ResponseFormat format;
+    if (mediaType == "application/cbor")
+      format = ResponseFormat::Cbor;
+    else if (mediaType == "application/msgpack" || mediaType == "application/x-msgpack" ||
+             mediaType == "application/vnd.msgpack")
+      format = ResponseFormat::MessagePack;
+    else if (mediaType == "application/json")
+      format = ResponseFormat::Json;
+    else
+      continue;
+
+    if (quality > bestQuality)
+    {
+      best = format;
+      bestQuality = quality;
+    }
+  }
+  return best;
+}
+
+const char *ResponseEncoder::contentType(ResponseFormat format)
+{
+  switch (format)
+  {
+  case ResponseFormat::Cbor:
+    return "application/cbor";
+  case ResponseFormat::MessagePack:
+    return "application/msgpack";
+  default:
+    return "application/json";
+  }
+}
+
+void ResponseEncoder::encode(const json &body, ResponseFormat format, std::ostream &out)
+{
+  // 해시를 바이너리로 바꾸는 바이너리 포맷에서만 복사한다
+  switch (format)
+  {
+  case ResponseFormat::Cbor:
+  {
+    json binary = body;
+    hashesToBinary(binary);
+    json::to_cbor(binary, out);
+    break;
+  }
+  case ResponseFormat::MessagePack:
+  {
+    json binary = body;
+    hashesToBinary(binary);
+    json::to_msgpack(binary, out);
+    break;
+  }
+  default:
+    out << body;
+    break;
+  }
+}
+
+void ResponseEncoder::hashesToBinary(json &body)
+{
+  if (body.is_array())
+  {
+    for (auto &item : body)
+      hashesToBinary(item);
+    return;
+  }
+  if (!body.is_object())
+    return;
+
+  for (auto it = body.begin(); it != body.end(); ++it)
+  {
+    auto &value = it.value();
+    if (!value.is_string())
+    {
+      hashesToBinary(value);
+      continue;
+    }
+    if (!isHashKey(it.key()))
+      continue;
+
+    const auto &hex = value.get_ref<const std::string &>();
+    if (hex.size() != HASH_HEX_LENGTH)
+      continue;
+    std::vector<std::uint8_t> bytes;
+    bytes.reserve(HASH_HEX_LENGTH / 2);
+    for (size_t i = 0; i < HASH_HEX_LENGTH; i += 2)
+    {
+      int high = hexValue(hex[i]), low = hexValue(hex[i + 1]);
+      if (high < 0 || low < 0)
+        break;
+      bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+    if (bytes.size() == HASH_HEX_LENGTH / 2)
+      value = json::binary(std::move(bytes));
+  }
+}
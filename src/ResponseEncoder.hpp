@@ -0,0 +1,33 @@
+#ifndef RESPONSEENCODER_HPP
+#define RESPONSEENCODER_HPP
+#include <cpprest/http_listener.h>
+#include <nlohmann/json.hpp>
+#include <ostream>
+#include <string>
+
+using json = nlohmann::json;
+
+enum class ResponseFormat
+{
+  Json,
+  Cbor,
+  MessagePack
+};
+
+/*
+ * Accept 헤더 기반 응답 포맷 협상.
+ * CBOR / MessagePack 응답에서는 txid, block_hash 같은 64자리 hex 해시를
+ * 32바이트 바이너리로 바꿔 전송한다. (바이트 순서는 hex 표기와 동일)
+ */
+class ResponseEncoder
+{
+public:
+  static ResponseFormat negotiate(const utility::string_t &accept);
+  static const char *contentType(ResponseFormat format);
+  static void encode(const json &body, ResponseFormat format, std::ostream &out);
+
+private:
+  static void hashesToBinary(json &body);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "ReusePort.hpp"
+
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+
+namespace
+{
+  std::atomic<uint16_t> reusePort(0); // 0 이면 끔
+
+  using BindFunction = int (*)(int, const struct sockaddr *, socklen_t);
+
+  // 리스너 포트로 bind 하는 IPv4/IPv6 주소인지
+  bool listenerAddress(const struct sockaddr *address, socklen_t length, uint16_t port)
+  {
+    if (address->sa_family == AF_INET && length >= sizeof(sockaddr_in))
+      return ntohs(reinterpret_cast<const sockaddr_in *>(address)->sin_port) == port;
+    if (address->sa_family == AF_INET6 && length >= sizeof(sockaddr_in6))
+      return ntohs(reinterpret_cast<const sockaddr_in6 *>(address)->sin6_port) == port;
+    return false;
+  }
+}
+
+void enableReusePort(uint16_t port)
+{
+  reusePort = port;
+}
+
+extern "C" int bind(int fd, const struct sockaddr *address, socklen_t length)
+{
+  static BindFunction next = reinterpret_cast<BindFunction>(dlsym(RTLD_NEXT, "bind"));
+  uint16_t port = reusePort;
+  if (port != 0 && address && listenerAddress(address, length, port))
+  {
+    int type = 0;
+    socklen_t size = sizeof(type);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &size) == 0 && type == SOCK_STREAM)
+    {
+      int on = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+  }
+  return next(fd, address, length);
+}
@@ -0,0 +1,12 @@
+#ifndef REUSEPORT_HPP
+#define REUSEPORT_HPP
+#include <cstdint>
+
+/*
+ * cpprest(boost asio) 리스너는 SO_REUSEPORT 를 설정할 방법이 없으므로
+ * bind 를 가로채서 port 에 bind 하는 TCP 소켓에만 SO_REUSEPORT 를 켠다.
+ * enableReusePort() 이후에 만들어지는 리스너에만 적용된다 (pre-fork 모드 전용).
+ */
+void enableReusePort(uint16_t port);
+
+#endif
@@ -0,0 +1,520 @@
+#include "SearchIndex.hpp"
+#include "ChainLock.hpp"
+#include "ThreadPool.hpp"
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+  const uint64_t SEARCH_INDEX_MAGIC = 0x58444e4948435253ULL; // "SRCHINDX"
+  const uint32_t SEARCH_INDEX_VERSION = 3;
+  const uint32_t KIND_TXID = 1;
+  const uint32_t KIND_ADDRESS = 2;
+  const size_t TABLE_SIZE = (1 << SEARCH_TOP_BITS) + 1;
+  const size_t DATA_OFFSET = sizeof(SearchHeader) + TABLE_SIZE * sizeof(uint64_t);
+  const uint64_t INVALID_KEY = std::numeric_limits<uint64_t>::max();
+
+  const size_t TXID_KEY_CHARS = 16;
+  const size_t ADDRESS_KEY_CHARS = 10;
+
+  /*
+   * 자동완성에 의미 있는 주소 문자열을 갖는 타입만 색인.
+   * PUBKEYHASH/WITNESS_PUBKEYHASH 와 SCRIPTHASH/WITNESS_SCRIPTHASH 는 각각 같은 scriptNum 을 공유하므로
+   * scriptNum 마다 실제 출력에 나타난 타입의 문자열만 넣는다.
+   * P2PK 출력은 같은 scriptNum 의 P2PKH 로 색인한다 (searchType)
+   */
+  const std::vector<blocksci::AddressType::Enum> SEARCH_ADDRESS_TYPES = {
+      blocksci::AddressType::PUBKEYHASH, blocksci::AddressType::WITNESS_PUBKEYHASH,
+      blocksci::AddressType::SCRIPTHASH, blocksci::AddressType::WITNESS_SCRIPTHASH,
+      blocksci::AddressType::WITNESS_UNKNOWN};
+
+  // P2PK 는 주소 문자열이 같은 scriptNum 의 P2PKH 와 같다
+  blocksci::AddressType::Enum searchType(blocksci::AddressType::Enum type)
+  {
+    return type == blocksci::AddressType::PUBKEY ? blocksci::AddressType::PUBKEYHASH : type;
+  }
+
+  bool searchable(blocksci::AddressType::Enum type)
+  {
+    type = searchType(type);
+    return std::find(SEARCH_ADDRESS_TYPES.begin(), SEARCH_ADDRESS_TYPES.end(), type) != SEARCH_ADDRESS_TYPES.end();
+  }
+
+  // 공유 scriptNum 공간에서 타입별로 쓰는 seen 비트
+  uint8_t seenBit(blocksci::AddressType::Enum type)
+  {
+    return type == blocksci::AddressType::WITNESS_PUBKEYHASH || type == blocksci::AddressType::WITNESS_SCRIPTHASH ? 2 : 1;
+  }
+
+  int hexValue(char c)
+  {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    return -1;
+  }
+
+  // ASCII 순서를 보존하는 6bit 코드. 0 은 문자열 끝
+  int addressCode(char c)
+  {
+    if (c == '-')
+      return 1;
+    if (c >= '0' && c <= '9')
+      return c - '0' + 2;
+    if (c >= 'A' && c <= 'Z')
+      return c - 'A' + 12;
+    if (c >= 'a' && c <= 'z')
+      return c - 'a' + 38;
+    return -1;
+  }
+
+  // prefix 뒤를 fill 로 채운 키. 표현할 수 없는 문자가 있으면 false
+  bool txidKey(const std::string &hex, int fill, uint64_t &key)
+  {
+    key = 0;
+    for (size_t i = 0; i < TXID_KEY_CHARS; ++i)
+    {
+      int value = i < hex.size() ? hexValue(hex[i]) : fill;
+      if (value < 0)
+        return false;
+      key = key << 4 | value;
+    }
+    return true;
+  }
+
+  bool addressKeyOf(const char *text, size_t length, int fill, uint64_t &key)
+  {
+    key = 0;
+    for (size_t i = 0; i < ADDRESS_KEY_CHARS; ++i)
+    {
+      int code = i < length ? addressCode(text[i]) : fill;
+      if (code < 0)
+        return false;
+      key = key << 6 | code;
+    }
+    key <<= 4;
+    if (fill == 63)
+      key |= 0xF;
+    return true;
+  }
+
+  void parallelSort(SearchRecord *data, size_t count)
+  {
+    auto &pool = ThreadPool::Instance();
+    size_t parts = std::max<size_t>(1, std::min(pool.size(), count / SEARCH_BUILD_CHUNK + 1));
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= parts; ++i)
+      bounds.push_back(count * i / parts);
+
+    std::vector<std::future<void>> futures;
+    for (size_t i = 0; i < parts; ++i)
+      futures.push_back(pool.submit([data, &bounds, i]
+                                    { std::sort(data + bounds[i], data + bounds[i + 1]); }));
+    for (auto &future : futures)
+      future.get();
+
+    // 인접한 구간끼리 병합
+    while (bounds.size() > 2)
+    {
+      std::vector<size_t> merged;
+      futures.clear();
+      for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+      {
+        merged.push_back(bounds[i]);
+        if (i + 2 < bounds.size())
+        {
+          size_t first = bounds[i], middle = bounds[i + 1], last = bounds[i + 2];
+          futures.push_back(pool.submit([data, first, middle, last]
+                                        { std::inplace_merge(data + first, data + middle, data + last); }));
+        }
+      }
+      merged.push_back(bounds.back());
+      for (auto &future : futures)
+        future.get();
+      bounds = std::move(merged);
+    }
+  }
+
+  // 정렬이 끝난 파일에 상위 테이블과 헤더를 기록하고 제자리로 옮긴다
+  void finishFile(MappedFile &file, const std::string &path, uint32_t kind, uint64_t count,
+                  int processedHeight, const std::array<uint32_t, 16> &typeCounts)
+  {
+    file.resize(DATA_OFFSET + count * sizeof(SearchRecord));
+    auto *records = reinterpret_cast<const SearchRecord *>(file.data() + DATA_OFFSET);
+    auto *table = reinterpret_cast<uint64_t *>(file.data() + sizeof(SearchHeader));
+    uint64_t position = 0;
+    for (size_t top = 0; top < TABLE_SIZE; ++top)
+    {
+      while (position < count && (records[position].key >> (64 - SEARCH_TOP_BITS)) < top)
+        ++position;
+      table[top] = position;
+    }
+    table[TABLE_SIZE - 1] = count;
+
+    auto &header = *reinterpret_cast<SearchHeader *>(file.data());
+    header.magic = SEARCH_INDEX_MAGIC;
+    header.version = SEARCH_INDEX_VERSION;
+    header.kind = kind;
+    header.processedHeight = processedHeight;
+    header.count = count;
+    header.typeCounts = typeCounts;
+    file.sync();
+    std::filesystem::rename(file.getPath(), path);
+  }
+
+  // [low, high] 키 구간의 시작과 끝
+  template <class Records>
+  std::pair<const SearchRecord *, const SearchRecord *> keyRange(const Records &records, uint64_t low, uint64_t high)
+  {
+    const SearchRecord *first = records.begin, *last = records.end;
+    if (records.table)
+    {
+      first = records.begin + records.table[low >> (64 - SEARCH_TOP_BITS)];
+      last = records.begin + records.table[(high >> (64 - SEARCH_TOP_BITS)) + 1];
+    }
+    first = std::lower_bound(first, last, SearchRecord{low, 0});
+    last = std::upper_bound(first, last, SearchRecord{high, 0});
+    return {first, last};
+  }
+}
+
+SearchIndex::SearchIndex(const std::string &directory, blocksci::Blockchain &chain)
+    : chain(chain), addressEncoder(chain),
+      txFile(directory + "/txids.dat", false), addressFile(directory + "/addresses.dat", false)
+{
+  view(txFile, KIND_TXID);
+  view(addressFile, KIND_ADDRESS);
+  // 두 파일은 같은 빌드에서 나와야 delta 가 이어 붙일 높이가 하나로 정해진다
+  height = reinterpret_cast<const SearchHeader *>(txFile.data())->processedHeight;
+  if (reinterpret_cast<const SearchHeader *>(addressFile.data())->processedHeight != height)
+    throw std::runtime_error("Incompatible search index, txids.dat and addresses.dat have different heights in " + directory);
+  txFile.advise(MADV_RANDOM);
+  addressFile.advise(MADV_RANDOM);
+}
+
+/* 전체 체인을 스캔해 기반 파일을 만든다. 임시 파일에 쓴 뒤 rename 하므로 중단돼도 기존 파일은 그대로다. */
+void SearchIndex::build(const std::string &directory, blocksci::Blockchain &chain)
+{
+  std::filesystem::create_directories(directory);
+  auto &pool = ThreadPool::Instance();
+  auto &access = chain.getAccess();
+  int last = chain.size() - 1;
+
+  // 출력에 나타난 (타입, scriptNum). 공유 공간이라 scriptNum 마다 타입별 비트를 둔다
+  std::vector<std::atomic<uint8_t>> pubkeySeen(chain.addressCount(blocksci::AddressType::PUBKEYHASH) + 1ULL);
+  std::vector<std::atomic<uint8_t>> scriptSeen(chain.addressCount(blocksci::AddressType::SCRIPTHASH) + 1ULL);
+  auto seenOf = [&pubkeySeen, &scriptSeen](blocksci::AddressType::Enum type) -> std::vector<std::atomic<uint8_t>> *
+  {
+    if (type == blocksci::AddressType::PUBKEYHASH || type == blocksci::AddressType::WITNESS_PUBKEYHASH)
+      return &pubkeySeen;
+    if (type == blocksci::AddressType::SCRIPTHASH || type == blocksci::AddressType::WITNESS_SCRIPTHASH)
+      return &scriptSeen;
+    return nullptr; // WITNESS_UNKNOWN 은 모두 출력에 나타난 것
+  };
+
+  // txid: 블록을 SEARCH_BUILD_CHUNK 거래 단위로 묶어 각자 정해진 위치에 기록하면서 출력 타입도 표시
+  {
+    std::vector<uint64_t> offsets(chain.size() + 1, 0);
+    for (int height = 0; height <= last; ++height)
+      offsets[height + 1] = offsets[height] + chain[height].size();
+    uint64_t count = offsets.back();
+
+    MappedFile file(directory + "/txids.dat.tmp", true);
+    file.resize(DATA_OFFSET + count * sizeof(SearchRecord));
+    auto *records = reinterpret_cast<SearchRecord *>(file.data() + DATA_OFFSET);
+
+    std::vector<std::future<void>> futures;
+    for (int first = 0; first <= last;)
+    {
+      int end = first + 1;
+      while (end <= last && offsets[end] - offsets[first] < SEARCH_BUILD_CHUNK)
+        ++end;
+      futures.push_back(pool.submit([&chain, &offsets, &seenOf, records, first, end]
+      {
+        for (int height = first; height < end; ++height)
+        {
+          uint64_t position = offsets[height];
+          for (const auto &tx : chain[height])
+          {
+            uint64_t key;
+            txidKey(tx.getHash().GetHex(), 0, key);
+            records[position++] = {key, static_cast<uint64_t>(height) << 32 | tx.txNum};
+            for (const auto &output : tx.outputs())
+            {
+              auto address = output.getAddress();
+              auto type = searchType(address.type);
+              auto *seen = seenOf(type);
+              if (seen && address.scriptNum < seen->size())
+                (*seen)[address.scriptNum].fetch_or(seenBit(type), std::memory_order_relaxed);
+            }
+          }
+        }
+      }));
+      first = end;
+    }
+    for (auto &future : futures)
+      future.get();
+
+    parallelSort(records, count);
+    finishFile(file, directory + "/txids.dat", KIND_TXID, count, last, {});
+    std::cout << "search index: " << count << " txids" << std::endl;
+  }
+
+  // 주소: 타입별로 출력에 나타난 scriptNum 만 인코딩. 구간마다 개수를 먼저 세고 정해진 위치에 기록하며,
+  // 표현할 수 없는 주소는 INVALID_KEY 로 뒤로 보낸다
+  {
+    struct Range
+    {
+      blocksci::AddressType::Enum type;
+      uint32_t first;
+      uint32_t end;
+      uint64_t offset;
+    };
+    std::array<uint32_t, 16> typeCounts{};
+    std::vector<Range> ranges;
+    for (auto type : SEARCH_ADDRESS_TYPES)
+    {
+      typeCounts[type] = chain.addressCount(type);
+      for (uint32_t first = 1; first <= typeCounts[type]; first += SEARCH_BUILD_CHUNK)
+        ranges.push_back({type, first, static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(first) + SEARCH_BUILD_CHUNK, typeCounts[type] + 1ULL)), 0});
+    }
+    auto seenIn = [&seenOf](const Range &range, uint32_t scriptNum)
+    {
+      auto *seen = seenOf(range.type);
+      return !seen || (scriptNum < seen->size() && ((*seen)[scriptNum].load(std::memory_order_relaxed) & seenBit(range.type)));
+    };
+
+    std::vector<std::future<uint64_t>> counts;
+    for (const auto &range : ranges)
+    {
+      counts.push_back(pool.submit([&seenIn, range]
+      {
+        uint64_t n = 0;
+        for (uint32_t scriptNum = range.first; scriptNum < range.end; ++scriptNum)
+          n += seenIn(range, scriptNum);
+        return n;
+      }));
+    }
+    uint64_t count = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+      ranges[i].offset = count;
+      count += counts[i].get();
+    }
+
+    MappedFile file(directory + "/addresses.dat.tmp", true);
+    file.resize(DATA_OFFSET + count * sizeof(SearchRecord));
+    auto *records = reinterpret_cast<SearchRecord *>(file.data() + DATA_OFFSET);
+    AddressEncoder encoder(chain);
+
+    std::vector<std::future<void>> futures;
+    for (const auto &range : ranges)
+    {
+      futures.push_back(pool.submit([&encoder, &access, &seenIn, range, records]
+      {
+        char buffer[MAX_ADDRESS_LENGTH];
+        SearchRecord *out = records + range.offset;
+        for (uint32_t scriptNum = range.first; scriptNum < range.end; ++scriptNum)
+        {
+          if (!seenIn(range, scriptNum))
+            continue;
+          blocksci::Address address(scriptNum, range.type, access);
+          uint64_t key;
+          size_t length = encoder.encode(address, buffer);
+          if (!addressKeyOf(buffer, length, 0, key))
+            key = INVALID_KEY;
+          *out++ = {key, addressKey(address)};
+        }
+      }));
+    }
+    for (auto &future : futures)
+      future.get();
+
+    parallelSort(records, count);
+    uint64_t valid = std::partition_point(records, records + count, [](const SearchRecord &record)
+                                          { return record.key != INVALID_KEY; }) - records;
+    finishFile(file, directory + "/addresses.dat", KIND_ADDRESS, valid, last, typeCounts);
+    std::cout << "search index: " << valid << " addresses" << std::endl;
+  }
+}
+
+size_t SearchIndex::update()
+{
+  auto chainLock = ChainLock::Instance().read();
+  int last = chain.size() - 1;
+  std::vector<SearchRecord> txs, addresses;
+  std::unordered_set<uint64_t> ids;
+  auto base = view(addressFile, KIND_ADDRESS);
+
+  // 새 블록의 거래와, 출력에 처음 나타난 (타입, scriptNum) 주소. 기반 파일과 delta 에 이미 있으면 건너뛴다
+  char buffer[MAX_ADDRESS_LENGTH];
+  int h = height + 1;
+  for (; h <= last && !stopping; ++h)
+  {
+    for (const auto &tx : chain[h])
+    {
+      uint64_t key;
+      txidKey(tx.getHash().GetHex(), 0, key);
+      txs.push_back({key, static_cast<uint64_t>(h) << 32 | tx.txNum});
+
+      for (const auto &output : tx.outputs())
+      {
+        auto address = output.getAddress();
+        if (!searchable(address.type))
+          continue;
+        address = blocksci::Address(address.scriptNum, searchType(address.type), chain.getAccess());
+        uint64_t id = addressKey(address);
+        if (addressIds.count(id) || ids.count(id))
+          continue;
+        if (!addressKeyOf(buffer, addressEncoder.encode(address, buffer), 0, key))
+          continue;
+        auto range = keyRange(base, key, key);
+        if (std::any_of(range.first, range.second, [id](const SearchRecord &record)
+                        { return record.id == id; }))
+          continue;
+        ids.insert(id);
+        addresses.push_back({key, id});
+      }
+    }
+  }
+  std::sort(txs.begin(), txs.end());
+  std::sort(addresses.begin(), addresses.end());
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto append = [](std::vector<SearchRecord> &delta, const std::vector<SearchRecord> &added)
+  {
+    size_t middle = delta.size();
+    delta.insert(delta.end(), added.begin(), added.end());
+    std::inplace_merge(delta.begin(), delta.begin() + middle, delta.end());
+  };
+  append(txDelta, txs);
+  append(addressDelta, addresses);
+  addressIds.insert(ids.begin(), ids.end());
+  height = std::max(height, h - 1); // 멈췄으면 다 읽은 블록까지만
+  return txs.size() + addresses.size();
+}
+
+int SearchIndex::processedHeight() const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return height;
+}
+
+json SearchIndex::search(const std::string &prefix, size_t limit)
+{
+  if (prefix.size() < SEARCH_MIN_PREFIX || prefix.size() > MAX_ADDRESS_LENGTH)
+    throw std::invalid_argument("prefix must be " + std::to_string(SEARCH_MIN_PREFIX) + " to " +
+                                std::to_string(MAX_ADDRESS_LENGTH) + " characters");
+  limit = std::min(std::max<size_t>(limit, 1), SEARCH_MAX_RESULTS);
+
+  std::string lower = prefix;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c)
+                 { return std::tolower(c); });
+  // bech32 주소는 대소문자 구분이 없으므로 소문자로 맞춘다
+  const std::string &segwitPrefix = chain.getAccess().config.chainConfig.segwitPrefix;
+  bool segwit = lower.compare(0, std::min(lower.size(), segwitPrefix.size()), segwitPrefix, 0, lower.size()) == 0;
+  const std::string &addressPrefix = segwit ? lower : prefix;
+
+  json txids = json::array(), addresses = json::array();
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  findTxids(view(txFile, KIND_TXID), lower, limit, txids);
+  findTxids({nullptr, txDelta.data(), txDelta.data() + txDelta.size()}, lower, limit, txids);
+  findAddresses(view(addressFile, KIND_ADDRESS), addressPrefix, limit, addresses);
+  findAddresses({nullptr, addressDelta.data(), addressDelta.data() + addressDelta.size()}, addressPrefix, limit, addresses);
+  lock.unlock();
+
+  auto byValue = [](const json &a, const json &b)
+  { return a["value"].get<std::string>() < b["value"].get<std::string>(); };
+  std::sort(txids.begin(), txids.end(), byValue);
+  std::sort(addresses.begin(), addresses.end(), byValue);
+
+  json res;
+  res["prefix"] = prefix;
+  res["results"] = json::array();
+  std::set<std::string> seen;
+  for (auto *group : {&txids, &addresses})
+  {
+    for (auto &item : *group)
+    {
+      if (res["results"].size() >= limit)
+        break;
+      if (seen.insert(item["value"].get<std::string>()).second)
+        res["results"].push_back(std::move(item));
+    }
+  }
+  return res;
+}
+
+SearchIndex::Records SearchIndex::view(const MappedFile &file, uint32_t kind)
+{
+  const auto *header = reinterpret_cast<const SearchHeader *>(file.data());
+  if (file.size() < DATA_OFFSET || header->magic != SEARCH_INDEX_MAGIC || header->version != SEARCH_INDEX_VERSION ||
+      header->kind != kind || file.size() != DATA_OFFSET + header->count * sizeof(SearchRecord))
+    throw std::runtime_error("Incompatible search index " + file.getPath());
+
+  Records records;
+  records.table = reinterpret_cast<const uint64_t *>(file.data() + sizeof(SearchHeader));
+  records.begin = reinterpret_cast<const SearchRecord *>(file.data() + DATA_OFFSET);
+  records.end = records.begin + header->count;
+  return records;
+}
+
+void SearchIndex::findTxids(const Records &records, const std::string &prefix, size_t limit, json &out) const
+{
+  uint64_t low, high;
+  if (prefix.size() > 64 || !txidKey(prefix, 0, low) || !txidKey(prefix, 15, high))
+    return;
+  if (std::any_of(prefix.begin(), prefix.end(), [](char c) { return hexValue(c) < 0; }))
+    return;
+
+  auto range = keyRange(records, low, high);
+  size_t found = 0;
+  for (auto it = range.first; it != range.second && found < limit; ++it)
+  {
+    auto height = static_cast<blocksci::BlockHeight>(it->id >> 32);
+    blocksci::Transaction tx(static_cast<uint32_t>(it->id), height, chain.getAccess());
+    std::string hash = tx.getHash().GetHex();
+    if (hash.compare(0, prefix.size(), prefix) != 0)
+      continue;
+    json doc;
+    doc["kind"] = "txid";
+    doc["value"] = hash;
+    doc["block_height"] = height;
+    out.push_back(std::move(doc));
+    ++found;
+  }
+}
+
+void SearchIndex::findAddresses(const Records &records, const std::string &prefix, size_t limit, json &out) const
+{
+  uint64_t low, high;
+  if (!addressKeyOf(prefix.data(), prefix.size(), 0, low) || !addressKeyOf(prefix.data(), prefix.size(), 63, high))
+    return;
+
+  auto range = keyRange(records, low, high);
+  size_t found = 0;
+  for (auto it = range.first; it != range.second && found < limit; ++it)
+  {
+    auto address = addressFromKey(it->id, chain.getAccess());
+    std::string value = addressEncoder.encode(address);
+    if (value.compare(0, prefix.size(), prefix) != 0)
+      continue;
+    json doc;
+    doc["kind"] = "address";
+    doc["value"] = value;
+    doc["type"] = addressTypeName(address.type);
+    out.push_back(std::move(doc));
+    ++found;
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef SEARCHINDEX_HPP
+#define SEARCHINDEX_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "AddressEncoder.hpp"
+#include "MappedFile.hpp"
+
+using json = nlohmann::json;
+
+const size_t SEARCH_TOP_BITS = 16;           // 상위 테이블이 나누는 키 비트 수
+const size_t SEARCH_MIN_PREFIX = 3;
+const size_t SEARCH_MAX_RESULTS = 100;
+const uint32_t SEARCH_BUILD_CHUNK = 1 << 20; // 오프라인 빌드 작업 하나가 맡는 거래/주소 수
+
+struct SearchRecord
+{
+  uint64_t key;
+  uint64_t id;
+
+  bool operator<(const SearchRecord &other) const { return key < other.key; }
+};
+
+struct SearchHeader
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t kind;
+  int32_t processedHeight;
+  uint32_t reserved;
+  uint64_t count;
+  std::array<uint32_t, 16> typeCounts; // 주소 파일: 생성 시점의 타입별 scriptNum 수
+};
+
+/*
+ * txid / 주소 자동완성용 prefix 인덱스.
+ * 파일마다 헤더, 키 상위 16bit 별 시작 위치 테이블, 키로 정렬된 {key, id} 레코드 배열이 이어진다.
+ *  - txid: key = 해시 hex 앞 16자리, id = (height << 32) | txNum
+ *  - 주소: key = 주소 앞 10글자를 6bit 씩 순서를 보존해 채운 값, id = addressKey
+ *    scriptNum 을 공유하는 타입(P2PKH/P2WPKH, P2SH/P2WSH)은 출력에 실제로 나타난 것만 넣고, P2PK 는 P2PKH 로 넣는다
+ * 키가 같은 구간은 실제 문자열로 다시 확인한다.
+ * 기반 파일은 --build-search-index 로 오프라인 생성하고,
+ * 그 뒤의 블록과 새 주소는 메모리의 정렬된 delta 에 추가한다.
+ */
+class SearchIndex
+{
+public:
+  SearchIndex(const std::string &directory, blocksci::Blockchain &chain);
+
+  static void build(const std::string &directory, blocksci::Blockchain &chain);
+
+  // 기반 파일 이후의 블록과 새 주소를 delta 에 반영하고 추가한 레코드 수를 반환
+  size_t update();
+  void stop() { stopping = true; }
+  json search(const std::string &prefix, size_t limit);
+
+  int processedHeight() const;
+
+private:
+  // 정렬된 레코드 구간. table 이 없으면 (delta) 전체를 이분 탐색한다.
+  struct Records
+  {
+    const uint64_t *table = nullptr;
+    const SearchRecord *begin = nullptr;
+    const SearchRecord *end = nullptr;
+  };
+
+  blocksci::Blockchain &chain;
+  AddressEncoder addressEncoder;
+  MappedFile txFile;
+  MappedFile addressFile;
+  mutable std::shared_mutex mutex;
+  std::vector<SearchRecord> txDelta;
+  std::vector<SearchRecord> addressDelta;
+  std::unordered_set<uint64_t> addressIds; // delta 에 넣은 주소의 addressKey
+  int height = -1;
+  std::atomic<bool> stopping{false};
+
+  static Records view(const MappedFile &file, uint32_t kind);
+
+  void findTxids(const Records &records, const std::string &prefix, size_t limit, json &out) const;
+  void findAddresses(const Records &records, const std::string &prefix, size_t limit, json &out) const;
+};
+
+#endif
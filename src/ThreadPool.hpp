@@ -0,0 +1,88 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * 고정 크기 작업 스레드 풀.
+ * 풀 안에서 실행 중인 작업이 다시 submit 후 future 를 기다리면 데드락이 날 수 있으므로
+ * 병렬 작업은 요청 처리 스레드(cpprest)에서만 나누고 모은다.
+ */
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+  {
+    for (size_t i = 0; i < threads; ++i)
+    {
+      workers.emplace_back([this]
+                           {
+        for (;;)
+        {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty())
+              return;
+            task = std::move(tasks.front());
+            tasks.pop();
+          }
+          task();
+        } });
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    for (auto &worker : workers)
+      worker.join();
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  static ThreadPool &Instance()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  size_t size() const { return workers.size(); }
+
+  template <class F>
+  auto submit(F &&function) -> std::future<decltype(function())>
+  {
+    using Result = decltype(function());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+    auto future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.emplace([task]
+                    { (*task)(); });
+    }
+    condition.notify_one();
+    return future;
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+
+#endif
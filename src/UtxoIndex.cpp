@@ -0,0 +1,135 @@
+#include "UtxoIndex.hpp"
+#include "AddressEncoder.hpp"
+#include "ThreadPool.hpp"
+#include "ChainLock.hpp"
+
+#include <algorithm>
+#include <future>
+
+UtxoIndex::UtxoIndex(size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<const OutputSpans> UtxoIndex::outputs(const blocksci::Address &address)
+{
+  uint64_t key = addressKey(address);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropStale();
+    auto find = cache.find(key);
+    if (find != cache.end())
+    {
+      lru.splice(lru.begin(), lru, find->second.order);
+      return find->second.outputs;
+    }
+  }
+
+  auto built = std::make_shared<const OutputSpans>(build(address));
+  if (built->size() > capacity)
+    return built;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (cache.count(key))
+    return cache[key].outputs;
+  lru.push_front(key);
+  cache[key] = Entry{built, lru.begin()};
+  cachedOutputs += built->size();
+  while (cachedOutputs > capacity && lru.size() > 1)
+  {
+    auto evict = cache.find(lru.back());
+    cachedOutputs -= evict->second.outputs->size();
+    cache.erase(evict);
+    lru.pop_back();
+  }
+  return built;
+}
+
+std::shared_ptr<const UtxoList> UtxoIndex::clusterUtxos(const std::string &target,
+                                                        const std::vector<blocksci::Address> &addresses,
+                                                        blocksci::BlockHeight height)
+{
+  // Mongo 클러스터는 주소가 추가될 수 있으므로 주소 수도 키에 넣는다
+  std::string cacheKey = target + "@" + std::to_string(height) + "#" + std::to_string(addresses.size());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    dropStale();
+    for (auto it = clusterCache.begin(); it != clusterCache.end(); ++it)
+    {
+      if (it->first == cacheKey)
+      {
+        clusterCache.splice(clusterCache.begin(), clusterCache, it);
+        return it->second;
+      }
+    }
+  }
+
+  // 주소를 작업 스레드 수만큼 나눠 병렬로 수집
+  auto &pool = ThreadPool::Instance();
+  size_t chunkSize = addresses.size() / pool.size() + 1;
+  std::vector<std::future<UtxoList>> futures;
+  for (size_t begin = 0; begin < addresses.size(); begin += chunkSize)
+  {
+    size_t end = std::min(begin + chunkSize, addresses.size());
+    futures.push_back(pool.submit([this, &addresses, begin, end, height]
+    {
+      UtxoList chunk;
+      for (size_t i = begin; i < end; ++i)
+      {
+        uint64_t key = addressKey(addresses[i]);
+        for (const auto &output : *outputs(addresses[i]))
+        {
+          if (output.created <= height && output.spent > height)
+            chunk.push_back({key, output.value, output.txNum, output.index, output.created});
+        }
+      }
+      return chunk;
+    }));
+  }
+  for (auto &future : futures)
+    future.wait();
+
+  UtxoList utxos;
+  for (auto &future : futures)
+  {
+    auto chunk = future.get();
+    utxos.insert(utxos.end(), chunk.begin(), chunk.end());
+  }
+  std::sort(utxos.begin(), utxos.end(), [](const Utxo &a, const Utxo &b)
+            { return a.value != b.value ? a.value > b.value : a.txNum != b.txNum ? a.txNum < b.txNum : a.index < b.index; });
+
+  auto result = std::make_shared<const UtxoList>(std::move(utxos));
+  std::lock_guard<std::mutex> lock(mutex);
+  clusterCache.emplace_front(cacheKey, result);
+  if (clusterCache.size() > UTXO_CLUSTER_CACHE_ENTRIES)
+    clusterCache.pop_back();
+  return result;
+}
+
+void UtxoIndex::dropStale()
+{
+  // 체인을 다시 읽은 뒤에는 새 출력과 소비가 빠진 구간이므로 모두 버린다
+  uint64_t current = ChainLock::Instance().generation();
+  if (current == generation)
+    return;
+  cache.clear();
+  lru.clear();
+  clusterCache.clear();
+  cachedOutputs = 0;
+  generation = current;
+}
+
+OutputSpans UtxoIndex::build(const blocksci::Address &address)
+{
+  OutputSpans res;
+  for (const auto &tx : address.getTransactions())
+  {
+    for (const auto &output : tx.outputs())
+    {
+      if (output.getAddress() != address)
+        continue;
+      blocksci::BlockHeight spent = NOT_SPENT;
+      if (output.isSpent())
+        spent = output.getSpendingInput()->getBlockHeight();
+      res.push_back({output.getValue(), tx.txNum, output.outputIndex(), tx.getBlockHeight(), spent});
+    }
+  }
+  return res;
+}
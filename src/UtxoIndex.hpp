@@ -0,0 +1,77 @@
+#ifndef UTXOINDEX_HPP
+#define UTXOINDEX_HPP
+#include <blocksci/blocksci.hpp>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const size_t UTXO_CACHE_OUTPUTS = 4 * 1024 * 1024;
+const size_t UTXO_CLUSTER_CACHE_ENTRIES = 16;
+const size_t UTXO_PAGE_SIZE = 100;
+const size_t MAX_UTXO_PAGE_SIZE = 1000;
+
+// 주소가 받은 출력 하나의 생성/소비 높이
+struct OutputSpan
+{
+  int64_t value;
+  uint32_t txNum;
+  uint16_t index;
+  blocksci::BlockHeight created;
+  blocksci::BlockHeight spent; // 미사용이면 NOT_SPENT
+};
+
+struct Utxo
+{
+  uint64_t address; // addressKey
+  int64_t value;
+  uint32_t txNum;
+  uint16_t index;
+  blocksci::BlockHeight height;
+};
+
+using OutputSpans = std::vector<OutputSpan>;
+using UtxoList = std::vector<Utxo>;
+
+/*
+ * 주소별 출력의 [생성, 소비) 높이 구간을 캐시해서 임의 높이의 UTXO 를 블록 재조회 없이 구한다.
+ * 주소 캐시는 전체 출력 수 기준 LRU, 클러스터 단위의 정렬된 결과는 (대상, 높이) 별로
+ * 소수만 보관해 같은 클러스터의 페이지 요청이 반복될 때 다시 계산하지 않는다.
+ */
+class UtxoIndex
+{
+public:
+  static constexpr blocksci::BlockHeight NOT_SPENT = std::numeric_limits<blocksci::BlockHeight>::max();
+
+  UtxoIndex(size_t capacity = UTXO_CACHE_OUTPUTS);
+
+  std::shared_ptr<const OutputSpans> outputs(const blocksci::Address &address);
+  // height 시점 미사용 출력, value 내림차순
+  std::shared_ptr<const UtxoList> clusterUtxos(const std::string &target,
+                                               const std::vector<blocksci::Address> &addresses,
+                                               blocksci::BlockHeight height);
+
+private:
+  struct Entry
+  {
+    std::shared_ptr<const OutputSpans> outputs;
+    std::list<uint64_t>::iterator order;
+  };
+
+  size_t capacity;
+  size_t cachedOutputs = 0;
+  uint64_t generation = 0; // 캐시를 채운 체인 generation
+  std::mutex mutex;
+  std::list<uint64_t> lru;
+  std::unordered_map<uint64_t, Entry> cache;
+  std::list<std::pair<std::string, std::shared_ptr<const UtxoList>>> clusterCache; // 앞쪽이 최근
+
+  static OutputSpans build(const blocksci::Address &address);
+  // mutex 를 잡은 채로 부른다
+  void dropStale();
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "WarmUp.hpp"
+#include "ChainLock.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+  // 앞에 있을수록 먼저 읽는다. 나머지 디렉터리는 그 뒤
+  const std::vector<std::string> PRIORITY_DIRECTORIES = {"chain", "hashIndex", "scripts", "addressesDb"};
+
+  size_t priorityOf(const std::filesystem::path &relative)
+  {
+    auto top = relative.begin()->string();
+    auto find = std::find(PRIORITY_DIRECTORIES.begin(), PRIORITY_DIRECTORIES.end(), top);
+    return find - PRIORITY_DIRECTORIES.begin();
+  }
+
+  uint64_t halfOfMemory()
+  {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<uint64_t>(pages) * pageSize / 2 : 0;
+  }
+}
+
+WarmUp::WarmUp(blocksci::Blockchain &chain, const std::string &dataDirectory, const WarmUpConfig &config)
+    : chain(chain), directory(dataDirectory), config(config)
+{
+  if (this->config.maxBytes == 0)
+    this->config.maxBytes = halfOfMemory();
+  if (this->config.threads < 1)
+    this->config.threads = 1;
+}
+
+WarmUp::~WarmUp()
+{
+  stop();
+}
+
+void WarmUp::start()
+{
+  begin = std::chrono::steady_clock::now();
+  deadline = begin + std::chrono::seconds(config.budgetSeconds);
+  if (!config.enabled)
+  {
+    elapsedMillis = 0;
+    finished = true;
+    return;
+  }
+
+  collectTargets();
+  for (int i = 0; i < config.threads; ++i)
+    workers.emplace_back(&WarmUp::prefetchFiles, this);
+
+  supervisor = std::thread([this]()
+  {
+    touchRecentBlocks();
+    for (auto &worker : workers)
+      worker.join();
+    elapsedMillis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+    finished = true;
+    std::cout << "warm-up: " << (bytesDone >> 20) << " / " << (bytesTotal >> 20) << " MB, "
+              << blocksDone << " recent blocks in " << elapsedMillis / 1000.0 << " s" << std::endl;
+  });
+}
+
+void WarmUp::stop()
+{
+  stopping = true;
+  if (supervisor.joinable())
+    supervisor.join();
+}
+
+bool WarmUp::ready() const
+{
+  return finished || std::chrono::steady_clock::now() >= deadline;
+}
+
+json WarmUp::status() const
+{
+  int64_t millis = elapsedMillis;
+  if (millis < 0)
+    millis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+  json res;
+  res["ready"] = ready();
+  res["state"] = !config.enabled ? "disabled" : finished ? "done" : ready() ? "budget_exceeded" : "warming";
+  res["files_done"] = filesDone.load();
+  res["files_total"] = targets.size();
+  res["bytes_done"] = bytesDone.load();
+  res["bytes_total"] = bytesTotal;
+  res["progress"] = bytesTotal == 0 ? 1.0 : static_cast<double>(bytesDone) / bytesTotal;
+  res["recent_blocks_done"] = blocksDone.load();
+  res["recent_blocks_total"] = std::min<int>(config.recentBlocks, chain.size());
+  res["seconds"] = millis / 1000.0;
+  res["budget_seconds"] = config.budgetSeconds;
+  return res;
+}
+
+std::string WarmUp::dataDirectory(const std::string &settingPath)
+{
+  std::ifstream file(settingPath);
+  if (!file)
+    throw std::runtime_error("Failed to open " + settingPath);
+  json setting = json::parse(file);
+  if (setting.contains("chainConfig") && setting["chainConfig"].contains("dataDirectory"))
+    return setting["chainConfig"]["dataDirectory"].get<std::string>();
+  if (setting.contains("dataDirectory"))
+    return setting["dataDirectory"].get<std::string>();
+  throw std::runtime_error("dataDirectory not found in " + settingPath);
+}
+
+bool WarmUp::halted() const
+{
+  return stopping || std::chrono::steady_clock::now() >= deadline;
+}
+
+void WarmUp::collectTargets()
+{
+  namespace fs = std::filesystem;
+  if (directory.empty() || !fs::is_directory(directory))
+    return;
+
+  std::vector<std::pair<size_t, Target>> found;
+  std::error_code error;
+  for (fs::recursive_directory_iterator it(directory, error), end; it != end; it.increment(error))
+  {
+    if (error)
+      break;
+    if (!it->is_regular_file(error))
+      continue;
+    auto relative = fs::relative(it->path(), directory, error);
+    found.push_back({priorityOf(relative), {it->path().string(), it->file_size(error)}});
+  }
+  std::sort(found.begin(), found.end(), [](const auto &a, const auto &b)
+            { return a.first != b.first ? a.first < b.first : a.second.path < b.second.path; });
+
+  // 우선순위 순으로 maxBytes 까지만
+  for (auto &item : found)
+  {
+    if (bytesTotal + item.second.size > config.maxBytes)
+      continue;
+    bytesTotal += item.second.size;
+    targets.push_back(std::move(item.second));
+  }
+}
+
+void WarmUp::prefetchFiles()
+{
+  for (size_t i = nextTarget++; i < targets.size() && !halted(); i = nextTarget++)
+  {
+    const auto &target = targets[i];
+    int fd = ::open(target.path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      for (uint64_t offset = 0; offset < target.size && !halted(); offset += WARMUP_CHUNK_BYTES)
+      {
+        uint64_t length = std::min(WARMUP_CHUNK_BYTES, target.size - offset);
+        readahead(fd, static_cast<off64_t>(offset), length);
+        bytesDone += length;
+      }
+      ::close(fd);
+    }
+    ++filesDone;
+  }
+}
+
+/* 최근 블록의 거래, 입출력, 주소를 한 번씩 접근해 BlockSci mmap 영역을 올려 둔다 */
+void WarmUp::touchRecentBlocks()
+{
+  auto chainLock = ChainLock::Instance().read();
+  int last = chain.size();
+  int first = std::max(0, last - config.recentBlocks);
+  uint64_t checksum = 0;
+  for (int height = last - 1; height >= first && !halted(); --height)
+  {
+    for (const auto &tx : chain[height])
+    {
+      checksum += tx.getHash().GetHex().size();
+      for (const auto &input : tx.inputs())
+        checksum += input.getAddress().scriptNum + input.getValue();
+      for (const auto &output : tx.outputs())
+        checksum += output.getAddress().scriptNum + output.isSpent();
+    }
+    ++blocksDone;
+  }
+  if (checksum == 0)
+    std::cout << "warm-up: no recent transactions" << std::endl;
+}
@@ -0,0 +1,75 @@
+#ifndef WARMUP_HPP
+#define WARMUP_HPP
+#include <blocksci/blocksci.hpp>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+
+const uint64_t WARMUP_CHUNK_BYTES = 64ULL << 20; // readahead 한 번에 요청하는 크기
+
+struct WarmUpConfig
+{
+  bool enabled = true;
+  int threads = 2;
+  int budgetSeconds = 300;  // 이 시간이 지나면 미리 읽기를 멈추고 ready 로 전환
+  int recentBlocks = 1000;  // 최근 블록의 거래/주소 데이터를 직접 접근해 둔다
+  uint64_t maxBytes = 0;    // 미리 읽을 최대 크기, 0 이면 물리 메모리의 절반
+};
+
+/*
+ * 기동 직후 BlockSci 데이터 파일을 page cache 로 미리 읽어 첫 요청의 page fault 를 줄인다.
+ * 인덱스 성격의 디렉터리부터 readahead 하고, 최근 블록 구간은 BlockSci 를 통해 직접 접근한다.
+ * 모두 끝나거나 시간 예산을 넘기면 ready() 가 true 가 된다.
+ */
+class WarmUp
+{
+public:
+  WarmUp(blocksci::Blockchain &chain, const std::string &dataDirectory, const WarmUpConfig &config);
+  ~WarmUp();
+
+  void start();
+  void stop();
+  bool ready() const;
+  json status() const;
+
+  // BlockSci 설정 파일에서 데이터 디렉터리를 읽는다
+  static std::string dataDirectory(const std::string &settingPath);
+
+private:
+  struct Target
+  {
+    std::string path;
+    uint64_t size;
+  };
+
+  blocksci::Blockchain &chain;
+  std::string directory;
+  WarmUpConfig config;
+  std::vector<Target> targets;
+  uint64_t bytesTotal = 0;
+  std::vector<std::thread> workers;
+  std::thread supervisor;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point deadline;
+
+  std::atomic<size_t> nextTarget{0};
+  std::atomic<uint64_t> filesDone{0};
+  std::atomic<uint64_t> bytesDone{0};
+  std::atomic<int> blocksDone{0};
+  std::atomic<int64_t> elapsedMillis{-1}; // 끝난 뒤에만 기록
+  std::atomic<bool> finished{false};
+  std::atomic<bool> stopping{false};
+
+  bool halted() const;
+  void collectTargets();
+  void prefetchFiles();
+  void touchRecentBlocks();
+};
+
+#endif
@@ -1,28 +1,238 @@
 #include <blocksci/blocksci.hpp>
 #include <iostream>
 #include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
 
 #include "Handler.hpp"
 #include "MongoDB.hpp"
+#include "ClusterIndex.hpp"
+#include "WarmUp.hpp"
+#include "SearchIndex.hpp"
+#include "ReusePort.hpp"
+#include "GraphExport.hpp"
+#include "AddressFilter.hpp"
+#include "ChainLock.hpp"
 
 std::atomic<bool> running(true);
 
+// 종료 신호에 멈출 인덱스/필터. stop() 은 atomic 플래그만 세우므로 시그널 핸들러에서 불러도 된다
+std::atomic<ClusterIndex *> stoppableClusterIndex(nullptr);
+std::atomic<SearchIndex *> stoppableSearchIndex(nullptr);
+std::atomic<AddressFilter *> stoppableAddressFilter(nullptr);
+
+const int WORKER_STABLE_SECONDS = 60;      // 이보다 오래 돈 작업 프로세스가 죽으면 실패 횟수를 초기화
+const int WORKER_MAX_RESTART_DELAY = 60;   // 연속 실패 시 재시작 간격 상한(초)
+
 void signalHandler(int signum)
 {
   running = false;
+  if (auto *index = stoppableClusterIndex.load())
+    index->stop();
+  if (auto *index = stoppableSearchIndex.load())
+    index->stop();
+  if (auto *filter = stoppableAddressFilter.load())
+    filter->stop();
   std::cout << "stop server" << std::endl;
 }
 
-int main()
+/* running 인 동안 interval 초마다 task 실행 (인덱스 갱신용) */
+std::thread periodic(int interval, std::function<void()> task)
+{
+  return std::thread([interval, task]()
+  {
+    while (running)
+    {
+      try
+      {
+        task();
+      }
+      catch (const std::exception &e)
+      {
+        std::cerr << "index update failed: " << e.what() << std::endl;
+      }
+      for (int i = 0; i < interval && running; ++i)
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+  });
+}
+
+/* 작업 프로세스 count 개를 fork 해서 유지. 비정상 종료한 작업 프로세스는 다시 띄우되
+   WORKER_STABLE_SECONDS 안에 연속으로 죽으면 재시작 간격을 1, 2, 4 ... WORKER_MAX_RESTART_DELAY 초로 늘린다.
+   종료 신호를 받으면 SIGTERM 으로 drain 을 요청한 뒤 drainSeconds 가 지나면 SIGKILL */
+int superviseWorkers(int count, int drainSeconds, const std::function<int()> &worker)
+{
+  using Clock = std::chrono::steady_clock;
+  std::map<pid_t, int> children;
+  std::vector<Clock::time_point> started(count), restartAt(count);
+  std::vector<int> failures(count, 0);
+  std::vector<bool> pending(count, false);
+
+  auto schedule = [&](int slot)
+  {
+    auto now = Clock::now();
+    failures[slot] = now - started[slot] < std::chrono::seconds(WORKER_STABLE_SECONDS) ? failures[slot] + 1 : 1;
+    int delay = std::min(WORKER_MAX_RESTART_DELAY, 1 << std::min(failures[slot] - 1, 6));
+    restartAt[slot] = now + std::chrono::seconds(delay);
+    pending[slot] = true;
+    return delay;
+  };
+  auto spawn = [&](int slot)
+  {
+    pending[slot] = false;
+    started[slot] = Clock::now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      int code = worker();
+      std::cout.flush();
+      _exit(code);
+    }
+    if (pid < 0)
+      std::cerr << "fork failed: " << std::strerror(errno) << ", retrying in " << schedule(slot) << "s" << std::endl;
+    else
+      children[pid] = slot;
+  };
+
+  for (int slot = 0; slot < count; ++slot)
+    spawn(slot);
+  std::cout << "supervisor: " << children.size() << " workers" << std::endl;
+
+  while (running)
+  {
+    for (int slot = 0; slot < count; ++slot)
+    {
+      if (pending[slot] && Clock::now() >= restartAt[slot])
+        spawn(slot);
+    }
+
+    int status;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid <= 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      continue;
+    }
+    auto find = children.find(pid);
+    if (find == children.end())
+      continue;
+    int slot = find->second;
+    children.erase(find);
+    std::cerr << "worker " << pid << " exited ("
+              << (WIFSIGNALED(status) ? "signal " + std::to_string(WTERMSIG(status)) : "code " + std::to_string(WEXITSTATUS(status)))
+              << "), restarting in " << schedule(slot) << "s" << std::endl;
+  }
+
+  for (const auto &child : children)
+    kill(child.first, SIGTERM);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(drainSeconds);
+  while (!children.empty() && std::chrono::steady_clock::now() < deadline)
+  {
+    int status;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid > 0)
+      children.erase(pid);
+    else
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  for (const auto &child : children)
+  {
+    std::cerr << "worker " << child.first << " did not drain in time" << std::endl;
+    kill(child.first, SIGKILL);
+    waitpid(child.first, nullptr, 0);
+  }
+  return 0;
+}
+
+/* COMPRESSION_* 환경 변수로 응답 압축 설정 (모두 선택 사항) */
+CompressionConfig loadCompressionConfig()
+{
+  CompressionConfig config;
+  if (const char *env = std::getenv("COMPRESSION_DISABLED"))
+    config.enabled = std::string(env) != "1";
+  if (const char *env = std::getenv("COMPRESSION_MIN_SIZE"))
+    config.minSize = std::stoul(env);
+  if (const char *env = std::getenv("COMPRESSION_LEVEL"))
+    config.level = std::stoi(env);
+  // 예: COMPRESSION_ROUTE_LEVELS="/cluster=9,/info/addr=4"
+  if (const char *env = std::getenv("COMPRESSION_ROUTE_LEVELS"))
+  {
+    std::stringstream routes(env);
+    std::string item;
+    while (std::getline(routes, item, ','))
+    {
+      auto pos = item.find('=');
+      if (pos == std::string::npos)
+        continue;
+      config.routeLevels[utility::conversions::to_string_t(item.substr(0, pos))] = std::stoi(item.substr(pos + 1));
+    }
+  }
+  return config;
+}
+
+/* WARMUP_* 환경 변수로 기동 워밍업 설정 (모두 선택 사항) */
+WarmUpConfig loadWarmUpConfig()
+{
+  WarmUpConfig config;
+  if (const char *env = std::getenv("WARMUP_DISABLED"))
+    config.enabled = std::string(env) != "1";
+  if (const char *env = std::getenv("WARMUP_THREADS"))
+    config.threads = std::stoi(env);
+  if (const char *env = std::getenv("WARMUP_BUDGET"))
+    config.budgetSeconds = std::stoi(env);
+  if (const char *env = std::getenv("WARMUP_RECENT_BLOCKS"))
+    config.recentBlocks = std::stoi(env);
+  if (const char *env = std::getenv("WARMUP_MAX_BYTES"))
+    config.maxBytes = std::stoull(env);
+  return config;
+}
+
+int main(int argc, char *argv[])
 {
   const char* mongo_uri_env = std::getenv("MONGO_URI");
   const char* blocksci_setting_env = std::getenv("BLOCKSCI_SETTING");
   const char* server_url_env = std::getenv("SERVER_URL");
 
+  // 오프라인 검색 인덱스 생성: ./info-server --build-search-index <dir>
+  if (argc == 3 && std::string(argv[1]) == "--build-search-index")
+  {
+    if (!blocksci_setting_env)
+    {
+      std::cerr << "BLOCKSCI_SETTING is not set." << std::endl;
+      return 1;
+    }
+    blocksci::Blockchain chain(blocksci_setting_env);
+    SearchIndex::build(argv[2], chain);
+    return 0;
+  }
+
+  // 주소 그래프 내보내기: ./info-server --export-graph <dir> [start] [end]
+  if (argc >= 3 && std::string(argv[1]) == "--export-graph")
+  {
+    if (!blocksci_setting_env)
+    {
+      std::cerr << "BLOCKSCI_SETTING is not set." << std::endl;
+      return 1;
+    }
+    blocksci::Blockchain chain(blocksci_setting_env);
+    int start = argc >= 4 ? std::stoi(argv[3]) : 0;
+    int end = argc >= 5 ? std::stoi(argv[4]) : chain.size() - 1;
+    GraphExport exporter(chain, argv[2]);
+    exporter.run(start, end);
+    return 0;
+  }
+
   if (!mongo_uri_env || !blocksci_setting_env || !server_url_env) 
   {
       std::cerr << "One or more required environment variables are not set." << std::endl;
@@ -35,28 +245,214 @@ int main()
   const std::string blocksciSetting(blocksci_setting_env);
   const utility::string_t serverUrl = utility::conversions::to_string_t(server_url_env);
 
-  // BlockSci와 Handler 객체를 초기화
+  // BlockSci 객체를 초기화
   blocksci::Blockchain chain(blocksciSetting);
-  Handler listener(serverUrl, chain, mongoUri);
+  const char *workers_env = std::getenv("WORKERS");
+  int workers = workers_env ? std::max(1, std::stoi(workers_env)) : 1;
 
   signal(SIGINT, signalHandler);  // Ctrl+C
   signal(SIGTERM, signalHandler); // 종료 명령
 
+  // 데이터 파일을 미리 읽는 동안에도 요청은 받되 /readyz 는 끝날 때까지 503
+  std::string dataDirectory;
   try
   {
-    listener.open().wait();
-    ucout << U("Listening for requests at: ") << listener.uri().to_string() << std::endl;
-    while (running)
+    dataDirectory = WarmUp::dataDirectory(blocksciSetting);
+  }
+  catch (const std::exception &e)
+  {
+    std::cerr << "warm-up: " << e.what() << ", skipping file prefetch" << std::endl;
+  }
+  WarmUp warmUp(chain, dataDirectory, loadWarmUpConfig());
+  warmUp.start();
+
+  // 증분 클러스터 인덱스 (CLUSTER_INDEX_DIR 설정 시). 새 블록을 주기적으로 반영한다.
+  std::unique_ptr<ClusterIndex> clusterIndex;
+  int clusterInterval = 60;
+  if (const char *cluster_index_env = std::getenv("CLUSTER_INDEX_DIR"))
+  {
+    const char *merge_change_env = std::getenv("CLUSTER_INDEX_MERGE_CHANGE");
+    const char *interval_env = std::getenv("CLUSTER_INDEX_INTERVAL");
+    bool mergeChange = merge_change_env && std::string(merge_change_env) == "1";
+    if (interval_env)
+      clusterInterval = std::stoi(interval_env);
+    clusterIndex = std::make_unique<ClusterIndex>(cluster_index_env, chain, mergeChange);
+  }
+
+  // txid / 주소 prefix 검색 인덱스 (SEARCH_INDEX_DIR 설정 시). 이후 블록은 메모리에 추가한다.
+  std::unique_ptr<SearchIndex> searchIndex;
+  int searchInterval = 60;
+  if (const char *search_index_env = std::getenv("SEARCH_INDEX_DIR"))
+  {
+    const char *interval_env = std::getenv("SEARCH_INDEX_INTERVAL");
+    if (interval_env)
+      searchInterval = std::stoi(interval_env);
+    try
     {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
+      searchIndex = std::make_unique<SearchIndex>(search_index_env, chain);
     }
+    catch (const std::exception &e)
+    {
+      std::cerr << "search index: " << e.what() << " (build it with --build-search-index)" << std::endl;
+    }
+  }
 
-    listener.close().wait();
+  // 체인/라벨 주소 bloom filter (ADDRESS_FILTER=1). 없는 주소 조회를 BlockSci 와 Mongo 없이 끝낸다.
+  std::unique_ptr<AddressFilter> addressFilter;
+  int addressFilterInterval = 60;
+  const char *address_filter_env = std::getenv("ADDRESS_FILTER");
+  if (address_filter_env && std::string(address_filter_env) == "1")
+  {
+    const char *bits_env = std::getenv("ADDRESS_FILTER_BITS_PER_KEY");
+    const char *interval_env = std::getenv("ADDRESS_FILTER_INTERVAL");
+    if (interval_env)
+      addressFilterInterval = std::stoi(interval_env);
+    addressFilter = std::make_unique<AddressFilter>(chain, mongoUri,
+                                                    bits_env ? std::stod(bits_env) : ADDRESS_FILTER_BITS_PER_KEY);
   }
-  catch (const std::exception &e)
+
+  // 먼지/대량 출력 요약 기본값 (요청의 dust, top 으로 덮어쓸 수 있다)
+  OutputLimits outputLimits;
+  if (const char *env = std::getenv("OUTPUT_DUST_THRESHOLD"))
+    outputLimits.dust = std::stoll(env);
+  if (const char *env = std::getenv("OUTPUT_TOP_N"))
+    outputLimits.topOutputs = std::stoul(env);
+
+  const CompressionConfig compression = loadCompressionConfig();
+  auto serve = [&]()
   {
-    std::cerr << "Error: " << e.what() << std::endl;
+    Handler listener(serverUrl, chain, mongoUri);
+    listener.setCompression(compression);
+    listener.setOutputLimits(outputLimits);
+    listener.setWarmUp(&warmUp);
+    if (clusterIndex)
+      listener.setClusterIndex(clusterIndex.get());
+    if (searchIndex)
+      listener.setSearchIndex(searchIndex.get());
+    if (addressFilter)
+      listener.setAddressFilter(addressFilter.get());
+
+    // pre-fork 모드의 작업 프로세스는 fork 시점 라벨 필터 사본을 가지므로 각자 주기적으로 다시 만든다
+    std::thread labelUpdater;
+    if (addressFilter && workers > 1)
+      labelUpdater = periodic(addressFilterInterval, [&addressFilter]()
+                              { addressFilter->updateLabels(); });
+
+    int code = 0;
+    try
+    {
+      listener.open().wait();
+      ucout << U("Listening for requests at: ") << listener.uri().to_string() << U(" (pid ") << getpid() << U(")") << std::endl;
+      while (running)
+      {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+
+      // 새 연결은 받지 않고 처리 중인 요청이 끝날 때까지 기다린다
+      listener.close().wait();
+    }
+    catch (const std::exception &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+      code = 1;
+    }
+    if (labelUpdater.joinable())
+    {
+      running = false; // 작업 프로세스가 끝나므로 갱신 스레드도 멈춘다
+      labelUpdater.join();
+    }
+    return code;
+  };
+
+  /*
+   * pre-fork 모드 (WORKERS > 1). supervisor 가 워밍업과 인덱스 따라잡기를 마친 뒤
+   * 작업 프로세스를 fork 하고, 작업 프로세스들은 같은 mmap 데이터와 page cache 를 공유하며
+   * SO_REUSEPORT 로 같은 포트에서 accept 한다. 인덱스 갱신 스레드는 돌리지 않는다.
+   * fork 전에는 ThreadPool 등 스레드를 만드는 객체를 쓰지 않아야 한다.
+   */
+  if (workers > 1)
+  {
+    // 따라잡는 동안 SIGTERM 을 받으면 시그널 핸들러가 바로 멈춘다
+    stoppableClusterIndex = clusterIndex.get();
+    stoppableSearchIndex = searchIndex.get();
+    stoppableAddressFilter = addressFilter.get();
+    while (!warmUp.ready() && running)
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+    warmUp.stop();
+    if (clusterIndex)
+      std::cout << "cluster index: " << clusterIndex->update() << " blocks, height " << clusterIndex->processedHeight() << std::endl;
+    if (searchIndex)
+      std::cout << "search index: " << searchIndex->update() << " entries, height " << searchIndex->processedHeight() << std::endl;
+    if (addressFilter)
+      std::cout << "address filter: " << addressFilter->update() << " keys" << std::endl;
+    if (!running)
+      return 0;
+
+    const char *drain_env = std::getenv("WORKER_DRAIN_SECONDS");
+    enableReusePort(web::uri(serverUrl).port());
+    return superviseWorkers(workers, drain_env ? std::stoi(drain_env) : 30, serve);
   }
 
-  return 0;
-}
\ No newline at end of file
+  // 새 블록이 요청과 인덱스 갱신에 보이도록 체인을 주기적으로 다시 읽는다 (0 이면 끔)
+  std::thread chainReloader, clusterUpdater, searchUpdater, filterUpdater;
+  const char *reload_env = std::getenv("CHAIN_RELOAD_INTERVAL");
+  int reloadInterval = reload_env ? std::stoi(reload_env) : 60;
+  if (reloadInterval > 0)
+  {
+    chainReloader = periodic(reloadInterval, [&chain]()
+    {
+      int before = chain.size();
+      ChainLock::Instance().reload(chain);
+      if (chain.size() > before)
+        std::cout << "chain: " << chain.size() - before << " new blocks, height " << chain.size() - 1 << std::endl;
+    });
+  }
+  if (clusterIndex)
+  {
+    clusterUpdater = periodic(clusterInterval, [&clusterIndex]()
+    {
+      int processed = clusterIndex->update();
+      if (processed > 0)
+        std::cout << "cluster index: " << processed << " blocks, height " << clusterIndex->processedHeight() << std::endl;
+    });
+  }
+  if (searchIndex)
+  {
+    searchUpdater = periodic(searchInterval, [&searchIndex]()
+    {
+      size_t added = searchIndex->update();
+      if (added > 0)
+        std::cout << "search index: " << added << " entries, height " << searchIndex->processedHeight() << std::endl;
+    });
+  }
+
+  if (addressFilter)
+  {
+    filterUpdater = periodic(addressFilterInterval, [&addressFilter]()
+    {
+      uint64_t added = addressFilter->update();
+      if (added > 0)
+        std::cout << "address filter: " << added << " keys" << std::endl;
+    });
+  }
+
+  int code = serve();
+
+  warmUp.stop();
+  if (clusterIndex)
+    clusterIndex->stop();
+  if (searchIndex)
+    searchIndex->stop();
+  if (addressFilter)
+    addressFilter->stop();
+  if (chainReloader.joinable())
+    chainReloader.join();
+  if (clusterUpdater.joinable())
+    clusterUpdater.join();
+  if (searchUpdater.joinable())
+    searchUpdater.join();
+  if (filterUpdater.joinable())
+    filterUpdater.join();
+
+  return code;
+}